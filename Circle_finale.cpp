@@ -1,60 +1,752 @@
 ﻿#include <iostream>
 #include <cmath>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <utility>
 using namespace std;
 
-class Circle{
+/* Круг хранит только радиус, длина окружности и площадь считаются при
+обращении. Так объект занимает sizeof(T) байт вместо трёх чисел, а запись
+не делает лишней работы. Всё, кроме set_area (там sqrt), работает в constexpr.
+Circle - на double, CircleF - на float */
+template<class T>
+class BasicCircle{
 private:
-    double radius;       //радиус
-    double ference;      //длина окружности
-    double area;         //площадь круга
+    T radius;       //радиус
+
+    static constexpr T PI = T(M_PI);
+
 public:
     // Конструктор
-    Circle(double r){
-        radius = r;
-        ference = 2 * M_PI * r;
-        area = M_PI * pow(r, 2);
-    }
+    constexpr BasicCircle(T r) : radius(r) {}
 
-    void set_radius(double r){
+    constexpr void set_radius(T r){
         radius = r;
-        ference = 2 * M_PI * r;
-        area = M_PI * pow(r, 2);
     }
 
-    void set_ference(double f){
-        ference = f;
-        radius = f / (2 * M_PI);
-        area = M_PI * pow(radius, 2);
+    constexpr void set_ference(T f){
+        radius = f / (2 * PI);
     }
 
-    void set_area(double a){
-        area = a;
-        radius = sqrt(a / M_PI);
-        ference = 2 * M_PI * radius;
+    void set_area(T a){
+        radius = sqrt(a / PI);
     }
 
-    double get_radius(){
+    constexpr T get_radius() const{
         return radius;
     }
 
-    double get_ference(){
-        return ference;
+    //длина окружности
+    constexpr T get_ference() const{
+        return 2 * PI * radius;
+    }
+
+    //площадь круга
+    constexpr T get_area() const{
+        return PI * radius * radius;
+    }
+};
+
+using Circle = BasicCircle<double>;
+using CircleF = BasicCircle<float>;
+
+static_assert(sizeof(Circle) == sizeof(double), "Circle must store only the radius");
+static_assert(sizeof(CircleF) == sizeof(float), "CircleF must store only the radius");
+
+
+/* Набор кругов в виде структуры массивов: радиусы, длины окружностей
+и площади лежат каждый в своём массиве подряд. Пересчёт одной величины
+в две другие - простые циклы без pow, которые компилятор векторизует
+(сборка с -O3 -march=native -fno-math-errno, иначе sqrt не векторизуется),
+а большие наборы ещё и делятся между потоками */
+class CircleBatch{
+private:
+    vector<double> radius;
+    vector<double> ference;
+    vector<double> area;
+
+    // Вызывает body(begin, end) для кусков [0, n), по куску на поток
+    template<class F>
+    static void parallel_for(size_t n, F body){
+        const size_t MIN_CHUNK = 1 << 15;
+        size_t threads = min<size_t>(max(1u, thread::hardware_concurrency()), (n + MIN_CHUNK - 1) / MIN_CHUNK);
+        if (threads <= 1){
+            body(size_t(0), n);
+            return;
+        }
+        vector<thread> workers;
+        size_t chunk = (n + threads - 1) / threads;
+        for (size_t t = 0; t < threads; ++t){
+            size_t begin = t * chunk, end = min(n, begin + chunk);
+            workers.emplace_back([=]{ body(begin, end); });
+        }
+        for (auto& worker : workers){
+            worker.join();
+        }
+    }
+
+public:
+    CircleBatch(size_t n = 0) : radius(n, 0.0), ference(n, 0.0), area(n, 0.0) {}
+
+    CircleBatch(const vector<double>& radii) : CircleBatch(radii.size()){
+        set_radius(radii.data());
+    }
+
+    size_t size() const{
+        return radius.size();
+    }
+
+    // Все радиусы сразу (массив из size() чисел)
+    void set_radius(const double* r){
+        double* rr = radius.data();
+        double* ff = ference.data();
+        double* aa = area.data();
+        parallel_for(size(), [=](size_t begin, size_t end){
+            for (size_t i = begin; i < end; ++i){
+                rr[i] = r[i];
+                ff[i] = 2 * M_PI * r[i];
+                aa[i] = M_PI * r[i] * r[i];
+            }
+        });
+    }
+
+    void set_ference(const double* f){
+        double* rr = radius.data();
+        double* ff = ference.data();
+        double* aa = area.data();
+        parallel_for(size(), [=](size_t begin, size_t end){
+            for (size_t i = begin; i < end; ++i){
+                double r = f[i] * (1 / (2 * M_PI));
+                ff[i] = f[i];
+                rr[i] = r;
+                aa[i] = M_PI * r * r;
+            }
+        });
+    }
+
+    void set_area(const double* a){
+        double* rr = radius.data();
+        double* ff = ference.data();
+        double* aa = area.data();
+        parallel_for(size(), [=](size_t begin, size_t end){
+            for (size_t i = begin; i < end; ++i){
+                double r = sqrt(a[i] * (1 / M_PI));
+                aa[i] = a[i];
+                rr[i] = r;
+                ff[i] = 2 * M_PI * r;
+            }
+        });
+    }
+
+    const double* get_radius() const{
+        return radius.data();
+    }
+
+    const double* get_ference() const{
+        return ference.data();
+    }
+
+    const double* get_area() const{
+        return area.data();
+    }
+
+    Circle operator[](size_t i) const{
+        return Circle(radius[i]);
+    }
+
+    // Площади колец между этими кругами и кругами inner того же размера
+    vector<double> annulus_area(const CircleBatch& inner) const{
+        if (inner.size() != size()){
+            throw invalid_argument("CircleBatch::annulus_area: batches have different sizes");
+        }
+        vector<double> result(size());
+        const double* outer_a = area.data();
+        const double* inner_a = inner.area.data();
+        double* dst = result.data();
+        parallel_for(size(), [=](size_t begin, size_t end){
+            for (size_t i = begin; i < end; ++i){
+                dst[i] = outer_a[i] - inner_a[i];
+            }
+        });
+        return result;
+    }
+
+    // Стоимость ограды по длине окружности
+    vector<double> perimeter_cost(double price) const{
+        vector<double> result(size());
+        const double* ff = ference.data();
+        double* dst = result.data();
+        parallel_for(size(), [=](size_t begin, size_t end){
+            for (size_t i = begin; i < end; ++i){
+                dst[i] = price * ff[i];
+            }
+        });
+        return result;
+    }
+
+    /* Задача про бассейн для всех кругов сразу: ограда по внешней окружности
+    плюс дорожка (кольцо между inner и этим кругом) */
+    vector<double> pool_cost(const CircleBatch& inner, double fence_price, double path_price) const{
+        if (inner.size() != size()){
+            throw invalid_argument("CircleBatch::pool_cost: batches have different sizes");
+        }
+        vector<double> result(size());
+        const double* ff = ference.data();
+        const double* outer_a = area.data();
+        const double* inner_a = inner.area.data();
+        double* dst = result.data();
+        parallel_for(size(), [=](size_t begin, size_t end){
+            for (size_t i = begin; i < end; ++i){
+                dst[i] = fence_price * ff[i] + path_price * (outer_a[i] - inner_a[i]);
+            }
+        });
+        return result;
+    }
+};
+
+// Круг с центром в точке (x, y)
+struct PositionedCircle{
+    double x = 0, y = 0;
+    Circle circle = Circle(0.0);
+
+    constexpr bool contains(double px, double py) const{
+        double dx = px - x, dy = py - y;
+        double r = circle.get_radius();
+        return dx * dx + dy * dy <= r * r;
+    }
+
+    // Касание тоже считается пересечением
+    constexpr bool overlaps(const PositionedCircle& other) const{
+        double dx = other.x - x, dy = other.y - y;
+        double r = circle.get_radius() + other.circle.get_radius();
+        return dx * dx + dy * dy <= r * r;
+    }
+};
+
+// Результат пакета запросов: номера кругов запроса q лежат в ids[offsets[q] .. offsets[q + 1])
+struct QueryResult{
+    vector<uint32_t> offsets;
+    vector<uint32_t> ids;
+};
+
+/* Равномерная сетка над набором кругов. Круг заносится во все ячейки,
+которые задевает его ограничивающий квадрат; ячейки хранятся одним массивом
+(сначала подсчёт, затем раскладка), без векторов на каждую ячейку.
+Хороша, когда радиусы примерно одинаковы. Сетка хранит ссылку на вектор
+кругов, а не копию: вектор должен жить дольше сетки и не меняться */
+class UniformGrid{
+private:
+    const vector<PositionedCircle>& circles;
+    double min_x = 0, min_y = 0, cell = 1;
+    int nx = 1, ny = 1;
+    vector<uint32_t> cell_start;   // начало ячейки k в items, размер nx * ny + 1
+    vector<uint32_t> items;
+
+    int cell_x(double x) const{
+        return min(nx - 1, max(0, int((x - min_x) / cell)));
+    }
+
+    int cell_y(double y) const{
+        return min(ny - 1, max(0, int((y - min_y) / cell)));
+    }
+
+public:
+    // Временный вектор умер бы раньше сетки
+    UniformGrid(vector<PositionedCircle>&&, double = 0) = delete;
+
+    // cell_size = 0 - размер ячейки по среднему диаметру
+    UniformGrid(const vector<PositionedCircle>& source, double cell_size = 0) : circles(source){
+        if (circles.empty()){
+            cell_start.assign(2, 0);
+            return;
+        }
+        double max_x = -INFINITY, max_y = -INFINITY, sum_r = 0.0;
+        min_x = INFINITY;
+        min_y = INFINITY;
+        for (const PositionedCircle& c : circles){
+            double r = c.circle.get_radius();
+            min_x = min(min_x, c.x - r);
+            min_y = min(min_y, c.y - r);
+            max_x = max(max_x, c.x + r);
+            max_y = max(max_y, c.y + r);
+            sum_r += r;
+        }
+        double width = max_x - min_x, height = max_y - min_y;
+        if (!isfinite(width) || !isfinite(height)){
+            throw invalid_argument("UniformGrid: circle coordinates must be finite");
+        }
+        cell = cell_size > 0 ? cell_size : max(2 * sum_r / circles.size(), 1e-9);
+        /* Не больше примерно четырёх ячеек на круг. Нулевая ширина или высота
+        (все круги на одной прямой) считается за одну ячейку, иначе ограничение
+        не сработает и число ячеек по другой оси переполнит int */
+        double limit = 4.0 * circles.size() + 16;
+        while (max(width, cell) / cell * (max(height, cell) / cell) > limit){
+            cell *= 2;
+        }
+        if (width / cell >= INT32_MAX || height / cell >= INT32_MAX){
+            throw length_error("UniformGrid: too many cells");
+        }
+        nx = int(width / cell) + 1;
+        ny = int(height / cell) + 1;
+
+        cell_start.assign(size_t(nx) * ny + 1, 0);
+        for (const PositionedCircle& c : circles){
+            double r = c.circle.get_radius();
+            for (int cy = cell_y(c.y - r); cy <= cell_y(c.y + r); ++cy){
+                for (int cx = cell_x(c.x - r); cx <= cell_x(c.x + r); ++cx){
+                    cell_start[size_t(cy) * nx + cx + 1]++;
+                }
+            }
+        }
+        for (size_t k = 1; k < cell_start.size(); ++k){
+            cell_start[k] += cell_start[k - 1];
+        }
+        items.resize(cell_start.back());
+        vector<uint32_t> fill_pos(cell_start.begin(), cell_start.end() - 1);
+        for (uint32_t i = 0; i < circles.size(); ++i){
+            const PositionedCircle& c = circles[i];
+            double r = c.circle.get_radius();
+            for (int cy = cell_y(c.y - r); cy <= cell_y(c.y + r); ++cy){
+                for (int cx = cell_x(c.x - r); cx <= cell_x(c.x + r); ++cx){
+                    items[fill_pos[size_t(cy) * nx + cx]++] = i;
+                }
+            }
+        }
+    }
+
+    // Круги, содержащие точку (x, y); добавляются в out
+    void query_point(double x, double y, vector<uint32_t>& out) const{
+        if (circles.empty())
+            return;
+        size_t k = size_t(cell_y(y)) * nx + cell_x(x);
+        for (uint32_t p = cell_start[k]; p < cell_start[k + 1]; ++p){
+            uint32_t i = items[p];
+            if (circles[i].contains(x, y))
+                out.push_back(i);
+        }
+    }
+
+    /* Круги, пересекающиеся с c. Круг может лежать в нескольких общих ячейках,
+    поэтому он засчитывается только в первой (левой нижней) общей ячейке */
+    void query_overlap(const PositionedCircle& c, vector<uint32_t>& out) const{
+        if (circles.empty())
+            return;
+        double r = c.circle.get_radius();
+        int qx0 = cell_x(c.x - r), qx1 = cell_x(c.x + r);
+        int qy0 = cell_y(c.y - r), qy1 = cell_y(c.y + r);
+        for (int cy = qy0; cy <= qy1; ++cy){
+            for (int cx = qx0; cx <= qx1; ++cx){
+                size_t k = size_t(cy) * nx + cx;
+                for (uint32_t p = cell_start[k]; p < cell_start[k + 1]; ++p){
+                    uint32_t i = items[p];
+                    const PositionedCircle& other = circles[i];
+                    double ro = other.circle.get_radius();
+                    if (cx != max(qx0, cell_x(other.x - ro)) || cy != max(qy0, cell_y(other.y - ro)))
+                        continue;
+                    if (c.overlaps(other))
+                        out.push_back(i);
+                }
+            }
+        }
+    }
+};
+
+/* Иерархия ограничивающих прямоугольников (BVH) над набором кругов.
+Строится делением по медиане центров вдоль длинной стороны; узлы лежат
+в одном массиве, обход запросов - явным стеком. Подходит для кругов
+сильно разного размера, где сетке трудно подобрать ячейку.
+Как и UniformGrid, хранит ссылку на вектор кругов */
+class BVH{
+private:
+    struct Node{
+        double x0, y0, x1, y1;
+        uint32_t first;   // лист: начало в order; внутренний узел: номер левого потомка
+        uint32_t count;   // 0 - внутренний узел
+        uint32_t right;   // внутренний узел: номер правого потомка
+    };
+
+    static const uint32_t LEAF_SIZE = 4;
+
+    const vector<PositionedCircle>& circles;
+    vector<Node> nodes;
+    vector<uint32_t> order;
+
+    uint32_t build(uint32_t begin, uint32_t end){
+        uint32_t index = nodes.size();
+        nodes.push_back(Node());
+        double x0 = INFINITY, y0 = INFINITY, x1 = -INFINITY, y1 = -INFINITY;
+        double cx0 = INFINITY, cy0 = INFINITY, cx1 = -INFINITY, cy1 = -INFINITY;
+        for (uint32_t p = begin; p < end; ++p){
+            const PositionedCircle& c = circles[order[p]];
+            double r = c.circle.get_radius();
+            x0 = min(x0, c.x - r);
+            y0 = min(y0, c.y - r);
+            x1 = max(x1, c.x + r);
+            y1 = max(y1, c.y + r);
+            cx0 = min(cx0, c.x);
+            cy0 = min(cy0, c.y);
+            cx1 = max(cx1, c.x);
+            cy1 = max(cy1, c.y);
+        }
+        nodes[index].x0 = x0;
+        nodes[index].y0 = y0;
+        nodes[index].x1 = x1;
+        nodes[index].y1 = y1;
+        if (end - begin <= LEAF_SIZE){
+            nodes[index].first = begin;
+            nodes[index].count = end - begin;
+            return index;
+        }
+        bool split_x = cx1 - cx0 >= cy1 - cy0;
+        uint32_t mid = begin + (end - begin) / 2;
+        nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, [&](uint32_t a, uint32_t b){
+            return split_x ? circles[a].x < circles[b].x : circles[a].y < circles[b].y;
+        });
+        uint32_t left = build(begin, mid);
+        uint32_t right = build(mid, end);
+        nodes[index].first = left;
+        nodes[index].count = 0;
+        nodes[index].right = right;
+        return index;
+    }
+
+    // Обход узлов, чей прямоугольник пересекает [x0, x1] x [y0, y1]
+    template<class F>
+    void visit(double x0, double y0, double x1, double y1, F leaf) const{
+        if (nodes.empty())
+            return;
+        uint32_t stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0){
+            const Node& node = nodes[stack[--top]];
+            if (node.x0 > x1 || node.x1 < x0 || node.y0 > y1 || node.y1 < y0)
+                continue;
+            if (node.count > 0){
+                for (uint32_t p = node.first; p < node.first + node.count; ++p){
+                    leaf(order[p]);
+                }
+            }
+            else{
+                stack[top++] = node.right;
+                stack[top++] = node.first;
+            }
+        }
+    }
+
+public:
+    BVH(vector<PositionedCircle>&&) = delete;
+
+    BVH(const vector<PositionedCircle>& source) : circles(source), order(source.size()){
+        for (uint32_t i = 0; i < order.size(); ++i){
+            order[i] = i;
+        }
+        if (!circles.empty()){
+            nodes.reserve(2 * circles.size() / LEAF_SIZE + 1);
+            build(0, order.size());
+        }
+    }
+
+    void query_point(double x, double y, vector<uint32_t>& out) const{
+        visit(x, y, x, y, [&](uint32_t i){
+            if (circles[i].contains(x, y))
+                out.push_back(i);
+        });
     }
 
-    double get_area(){
-        return area;
+    void query_overlap(const PositionedCircle& c, vector<uint32_t>& out) const{
+        double r = c.circle.get_radius();
+        visit(c.x - r, c.y - r, c.x + r, c.y + r, [&](uint32_t i){
+            if (c.overlaps(circles[i]))
+                out.push_back(i);
+        });
     }
 };
 
+// Вызывает body(thread_index, begin, end) для кусков [0, n), по куску на поток
+template<class F>
+void parallel_chunks(size_t n, F body){
+    size_t threads = min<size_t>(max(1u, thread::hardware_concurrency()), max<size_t>(1, n / 1024));
+    vector<thread> workers;
+    size_t chunk = (n + threads - 1) / threads;
+    for (size_t t = 0; t < threads; ++t){
+        size_t begin = min(n, t * chunk), end = min(n, begin + chunk);
+        workers.emplace_back([=]{ body(t, begin, end); });
+    }
+    for (auto& worker : workers){
+        worker.join();
+    }
+}
+
+// Пакет запросов "какие круги содержат точку (xs[q], ys[q])", параллельно по запросам
+template<class Index>
+QueryResult batch_query_points(const Index& index, const vector<double>& xs, const vector<double>& ys){
+    size_t n = xs.size();
+    vector<vector<uint32_t>> parts(thread::hardware_concurrency() + 1);
+    vector<uint32_t> counts(n);
+    parallel_chunks(n, [&](size_t t, size_t begin, size_t end){
+        for (size_t q = begin; q < end; ++q){
+            size_t before = parts[t].size();
+            index.query_point(xs[q], ys[q], parts[t]);
+            counts[q] = parts[t].size() - before;
+        }
+    });
+    QueryResult result;
+    result.offsets.resize(n + 1, 0);
+    for (size_t q = 0; q < n; ++q){
+        result.offsets[q + 1] = result.offsets[q] + counts[q];
+    }
+    // Куски идут по порядку запросов, поэтому достаточно склеить их
+    result.ids.reserve(result.offsets[n]);
+    for (auto& part : parts){
+        result.ids.insert(result.ids.end(), part.begin(), part.end());
+    }
+    return result;
+}
+
+// Пакет запросов "какие круги пересекаются с queries[q]"
+template<class Index>
+QueryResult batch_query_overlaps(const Index& index, const vector<PositionedCircle>& queries){
+    size_t n = queries.size();
+    vector<vector<uint32_t>> parts(thread::hardware_concurrency() + 1);
+    vector<uint32_t> counts(n);
+    parallel_chunks(n, [&](size_t t, size_t begin, size_t end){
+        for (size_t q = begin; q < end; ++q){
+            size_t before = parts[t].size();
+            index.query_overlap(queries[q], parts[t]);
+            counts[q] = parts[t].size() - before;
+        }
+    });
+    QueryResult result;
+    result.offsets.resize(n + 1, 0);
+    for (size_t q = 0; q < n; ++q){
+        result.offsets[q + 1] = result.offsets[q] + counts[q];
+    }
+    result.ids.reserve(result.offsets[n]);
+    for (auto& part : parts){
+        result.ids.insert(result.ids.end(), part.begin(), part.end());
+    }
+    return result;
+}
+
+// Все пары пересекающихся кругов (i < j), параллельно по i
+template<class Index>
+vector<pair<uint32_t, uint32_t>> all_overlapping_pairs(const Index& index, const vector<PositionedCircle>& circles){
+    vector<vector<pair<uint32_t, uint32_t>>> parts(thread::hardware_concurrency() + 1);
+    parallel_chunks(circles.size(), [&](size_t t, size_t begin, size_t end){
+        vector<uint32_t> found;
+        for (size_t i = begin; i < end; ++i){
+            found.clear();
+            index.query_overlap(circles[i], found);
+            for (uint32_t j : found){
+                if (j > i)
+                    parts[t].emplace_back(i, j);
+            }
+        }
+    });
+    vector<pair<uint32_t, uint32_t>> result;
+    for (auto& part : parts){
+        result.insert(result.end(), part.begin(), part.end());
+    }
+    return result;
+}
+
+
+/* Замеры: кругов в секунду для отдельных объектов Circle и для CircleBatch.
+Запуск: ./Circle_finale bench [количество кругов] (по умолчанию 10000000) */
+void benchmark(int count){
+    mt19937 generator(42);
+    uniform_real_distribution<double> distribution(1.0, 100.0);
+    vector<double> values(count);
+    for (double& v : values){
+        v = distribution(generator);
+    }
+    double checksum = 0.0;
+
+    auto measure = [&](const char* name, auto body){
+        auto start = chrono::steady_clock::now();
+        body();
+        double t = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << name << ": " << count / t << " krugov/s" << endl;
+    };
+
+    vector<Circle> circles(count, Circle(0.0));
+    measure("Circle::set_radius", [&]{
+        for (int i = 0; i < count; ++i){
+            circles[i].set_radius(values[i]);
+        }
+        checksum += circles[count / 2].get_area();
+    });
+    measure("Circle::set_area", [&]{
+        for (int i = 0; i < count; ++i){
+            circles[i].set_area(values[i]);
+        }
+        checksum += circles[count / 2].get_radius();
+    });
+
+    CircleBatch batch(count), inner(count);
+    measure("CircleBatch::set_radius", [&]{
+        batch.set_radius(values.data());
+        checksum += batch.get_area()[count / 2];
+    });
+    measure("CircleBatch::set_area", [&]{
+        batch.set_area(values.data());
+        checksum += batch.get_radius()[count / 2];
+    });
+    measure("CircleBatch::set_ference", [&]{
+        batch.set_ference(values.data());
+        checksum += batch.get_radius()[count / 2];
+    });
+
+    inner.set_radius(values.data());
+    vector<double> outer_radius(values);
+    for (double& r : outer_radius){
+        r += 1.0;
+    }
+    batch.set_radius(outer_radius.data());
+    measure("Circle: bassein po odnomu", [&]{
+        for (int i = 0; i < count; ++i){
+            Circle pool(values[i] + 1.0);
+            checksum += 2000 * pool.get_ference() + 1000 * (pool.get_area() - M_PI * pow(values[i], 2));
+        }
+    });
+    measure("CircleBatch::pool_cost", [&]{
+        vector<double> cost = batch.pool_cost(inner, 2000, 1000);
+        checksum += cost[count / 2];
+    });
+
+    // Память и чтение: три поля, как было раньше, против одного радиуса
+    struct EagerCircle{
+        double radius, ference, area;
+    };
+    vector<EagerCircle> eager(count);
+    vector<CircleF> circles_f(count, CircleF(0.0f));
+    for (int i = 0; i < count; ++i){
+        eager[i] = {values[i], 2 * M_PI * values[i], M_PI * values[i] * values[i]};
+        circles[i].set_radius(values[i]);
+        circles_f[i].set_radius(float(values[i]));
+    }
+    cout << "pamyat: tri polya " << sizeof(EagerCircle) * count / 1048576 << " MB, Circle "
+         << sizeof(Circle) * count / 1048576 << " MB, CircleF " << sizeof(CircleF) * count / 1048576 << " MB" << endl;
+    measure("summa ploshadei, tri polya", [&]{
+        double total = 0.0;
+        for (const EagerCircle& c : eager){
+            total += c.area;
+        }
+        checksum += total;
+    });
+    measure("summa ploshadei, Circle", [&]{
+        double total = 0.0;
+        for (const Circle& c : circles){
+            total += c.get_area();
+        }
+        checksum += total;
+    });
+    measure("summa ploshadei, CircleF", [&]{
+        float total = 0.0f;
+        for (const CircleF& c : circles_f){
+            total += c.get_area();
+        }
+        checksum += total;
+    });
+    cout << "(" << checksum << ")" << endl;
+}
+
+
+/* Замеры пространственных индексов: построение, пакеты запросов и поиск
+всех пересекающихся пар; полный перебор проверяется на первых кругах.
+Запуск: ./Circle_finale bench index [количество кругов] (по умолчанию 1000000) */
+void benchmark_index(int count){
+    mt19937 generator(42);
+    double side = sqrt(double(count)) * 2.0;   // в среднем около двух пересечений на круг
+    uniform_real_distribution<double> position(0.0, side), radius(0.2, 0.6);
+    vector<PositionedCircle> circles(count);
+    for (PositionedCircle& c : circles){
+        c.x = position(generator);
+        c.y = position(generator);
+        c.circle = Circle(radius(generator));
+    }
+    int query_count = 100000;
+    vector<double> xs(query_count), ys(query_count);
+    for (int q = 0; q < query_count; ++q){
+        xs[q] = position(generator);
+        ys[q] = position(generator);
+    }
+
+    auto seconds_since = [](chrono::steady_clock::time_point start){
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    };
+
+    auto start = chrono::steady_clock::now();
+    UniformGrid grid(circles);
+    cout << "UniformGrid: postroenie " << seconds_since(start) << " s" << endl;
+    start = chrono::steady_clock::now();
+    BVH bvh(circles);
+    cout << "BVH: postroenie " << seconds_since(start) << " s" << endl;
+
+    auto run = [&](const char* name, const auto& index){
+        auto start = chrono::steady_clock::now();
+        QueryResult points = batch_query_points(index, xs, ys);
+        double t = seconds_since(start);
+        cout << name << ": " << query_count / t << " tochek/s (" << points.ids.size() << " popadanii)" << endl;
+        start = chrono::steady_clock::now();
+        vector<pair<uint32_t, uint32_t>> pairs = all_overlapping_pairs(index, circles);
+        t = seconds_since(start);
+        cout << name << ": vse pary za " << t << " s (" << pairs.size() << " par)" << endl;
+        return pairs.size();
+    };
+    size_t grid_pairs = run("UniformGrid", grid);
+    size_t bvh_pairs = run("BVH", bvh);
+    if (grid_pairs != bvh_pairs)
+        cout << "OSHIBKA: indeksy nashli raznoe chislo par" << endl;
+
+    // Полный перебор квадратичный, поэтому только на круги из угла примерно в 5000 штук
+    double window = side * sqrt(min(1.0, 5000.0 / count));
+    vector<PositionedCircle> subset;
+    for (const PositionedCircle& c : circles){
+        if (c.x < window && c.y < window)
+            subset.push_back(c);
+    }
+    int brute_count = subset.size();
+    start = chrono::steady_clock::now();
+    size_t brute_pairs = 0;
+    for (int i = 0; i < brute_count; ++i){
+        for (int j = i + 1; j < brute_count; ++j){
+            brute_pairs += subset[i].overlaps(subset[j]);
+        }
+    }
+    double t = seconds_since(start);
+    UniformGrid subset_grid(subset);
+    size_t indexed_pairs = all_overlapping_pairs(subset_grid, subset).size();
+    cout << "perebor " << brute_count << " krugov: " << t << " s (" << brute_pairs << " par, indeks "
+         << indexed_pairs << ")" << endl;
+}
+
+
+int main(int argc, char* argv[]){
+    if (argc > 1 && string(argv[1]) == "bench"){
+        if (argc > 2 && string(argv[2]) == "index"){
+            benchmark_index(argc > 3 ? stoi(argv[3]) : 1000000);
+            return 0;
+        }
+        benchmark(argc > 2 ? stoi(argv[2]) : 10000000);
+        return 0;
+    }
 
-int main(){
-    // Земля и верёвка
-    double earth_radius = 6378.1f;
-    Circle earth(earth_radius);
-    double new_ference = earth.get_ference() + 1; 
-    earth.set_ference(new_ference);
-    double new_radius = earth.get_radius();
-    double gap = new_radius - earth_radius;
+    // Земля и верёвка (считается при компиляции)
+    constexpr double earth_radius = 6378.1f;
+    constexpr double gap = []{
+        Circle earth(earth_radius);
+        double new_ference = earth.get_ference() + 1;
+        earth.set_ference(new_ference);
+        double new_radius = earth.get_radius();
+        return new_radius - earth_radius;
+    }();
     cout << "Zazor = " << gap << " km" << endl;
 
     // Бассейн
@@ -1,102 +1,1357 @@
 ﻿#include <iostream>
 #include <ctime>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <stdexcept>
+#include <cstdint>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cctype>
+#include <cstdlib>
 using namespace std;
 
+/* Часовой пояс из файла TZif (/usr/share/zoneinfo/<имя>).
+Файл читается один раз и кэшируется; таблица переходов после загрузки
+не меняется, поэтому смещение ищется двоичным поиском без блокировок из
+любого числа потоков. Для моментов после последнего перехода в таблице
+используется правило POSIX TZ из конца файла (например "CET-1CEST,M3.5.0,M10.5.0/3") */
+class TimeZone{
+private:
+    // День правила: Mm.w.d (MONTH), Jn - день года без 29 февраля (JULIAN), n - с ним (ZERO_BASED)
+    struct RuleDate{
+        enum Kind { MONTH, JULIAN, ZERO_BASED } kind = MONTH;
+        int month = 0, week = 0, weekday = 0, day = 0;
+        int32_t time = 7200;   // местное время перехода, по умолчанию 02:00
+    };
+
+    string zone_name;
+    vector<int64_t> transitions;   // моменты переходов (UTC, секунды от 1970 года)
+    vector<int32_t> offsets;       // смещение от UTC после перехода i
+    int32_t initial_offset = 0;
+
+    bool has_rule = false;
+    bool has_dst = false;
+    int32_t std_offset = 0, dst_offset = 0;
+    RuleDate dst_start, dst_end;
+
+    static int64_t read_be(const unsigned char* p, int size){
+        uint64_t value = 0;
+        for (int i = 0; i < size; ++i){
+            value = (value << 8) | p[i];
+        }
+        if (size == 4)
+            return (int32_t)(uint32_t)value;
+        return (int64_t)value;
+    }
+
+    // Смещение вида [+-]hh[:mm[:ss]]; в POSIX TZ знак обратный ("CET-1" = UTC+1)
+    static bool parse_offset(const string& s, size_t& pos, int32_t& seconds){
+        int sign = 1;
+        if (pos < s.size() && (s[pos] == '+' || s[pos] == '-')){
+            sign = s[pos] == '-' ? -1 : 1;
+            pos++;
+        }
+        int parts[3] = {0, 0, 0};
+        for (int k = 0; k < 3; ++k){
+            if (k > 0){
+                if (pos >= s.size() || s[pos] != ':')
+                    break;
+                pos++;
+            }
+            size_t start = pos;
+            while (pos < s.size() && isdigit((unsigned char)s[pos])){
+                parts[k] = parts[k] * 10 + (s[pos] - '0');
+                pos++;
+            }
+            if (pos == start)
+                return false;
+        }
+        seconds = sign * (parts[0] * 3600 + parts[1] * 60 + parts[2]);
+        return true;
+    }
+
+    static bool parse_name(const string& s, size_t& pos){
+        size_t start = pos;
+        if (pos < s.size() && s[pos] == '<'){
+            pos = s.find('>', pos);
+            if (pos == string::npos)
+                return false;
+            pos++;
+            return true;
+        }
+        while (pos < s.size() && isalpha((unsigned char)s[pos])){
+            pos++;
+        }
+        return pos - start >= 3;
+    }
+
+    static bool parse_rule_date(const string& s, size_t& pos, RuleDate& date){
+        int32_t value;
+        if (pos < s.size() && s[pos] == 'M'){
+            pos++;
+            date.kind = RuleDate::MONTH;
+            int* fields[3] = {&date.month, &date.week, &date.weekday};
+            for (int k = 0; k < 3; ++k){
+                if (k > 0){
+                    if (pos >= s.size() || s[pos] != '.')
+                        return false;
+                    pos++;
+                }
+                size_t start = pos;
+                *fields[k] = 0;
+                while (pos < s.size() && isdigit((unsigned char)s[pos])){
+                    *fields[k] = *fields[k] * 10 + (s[pos] - '0');
+                    pos++;
+                }
+                if (pos == start)
+                    return false;
+            }
+        }
+        else{
+            date.kind = RuleDate::ZERO_BASED;
+            if (pos < s.size() && s[pos] == 'J'){
+                date.kind = RuleDate::JULIAN;
+                pos++;
+            }
+            size_t start = pos;
+            date.day = 0;
+            while (pos < s.size() && isdigit((unsigned char)s[pos])){
+                date.day = date.day * 10 + (s[pos] - '0');
+                pos++;
+            }
+            if (pos == start)
+                return false;
+        }
+        if (pos < s.size() && s[pos] == '/'){
+            pos++;
+            if (!parse_offset(s, pos, value))
+                return false;
+            date.time = value;
+        }
+        return true;
+    }
+
+    void parse_footer(const string& tz){
+        size_t pos = 0;
+        int32_t value;
+        if (!parse_name(tz, pos) || !parse_offset(tz, pos, value))
+            return;
+        std_offset = -value;
+        has_rule = true;
+        if (pos >= tz.size())
+            return;
+        if (!parse_name(tz, pos)){
+            has_rule = false;
+            return;
+        }
+        dst_offset = std_offset + 3600;
+        if (pos < tz.size() && tz[pos] != ','){
+            if (!parse_offset(tz, pos, value)){
+                has_rule = false;
+                return;
+            }
+            dst_offset = -value;
+        }
+        if (pos >= tz.size() || tz[pos] != ','){
+            has_rule = false;
+            return;
+        }
+        pos++;
+        if (!parse_rule_date(tz, pos, dst_start) || pos >= tz.size() || tz[pos] != ','){
+            has_rule = false;
+            return;
+        }
+        pos++;
+        if (!parse_rule_date(tz, pos, dst_end)){
+            has_rule = false;
+            return;
+        }
+        has_dst = true;
+    }
+
+    // Местное время (секунды от 1970 года) перехода по правилу в году year
+    static int64_t rule_local_time(const RuleDate& date, int year);
+
+    int32_t rule_offset(int64_t utc) const;
+
+    TimeZone(const string& name, const vector<unsigned char>& file) : zone_name(name){
+        auto bad = [&]{ return runtime_error("TimeZone: " + name + " is not a valid TZif file"); };
+        if (file.size() < 44 || string(file.begin(), file.begin() + 4) != "TZif"){
+            throw bad();
+        }
+        auto counts = [&](size_t at, int64_t c[6]){
+            if (at + 44 > file.size())
+                throw bad();
+            for (int k = 0; k < 6; ++k){
+                c[k] = read_be(&file[at + 20 + 4 * k], 4);
+            }
+        };
+        // Порядок счётчиков: isutcnt, isstdcnt, leapcnt, timecnt, typecnt, charcnt
+        int64_t c[6];
+        counts(0, c);
+        size_t header = 0;
+        int time_size = 4;
+        if (file[4] >= '2'){
+            // Пропускаем данные версии 1 и читаем 64-битный блок
+            header = 44 + c[3] * 4 + c[3] + c[4] * 6 + c[5] + c[2] * 8 + c[1] + c[0];
+            counts(header, c);
+            time_size = 8;
+        }
+        size_t p = header + 44;
+        size_t need = c[3] * time_size + c[3] + c[4] * 6 + c[5] + c[2] * (time_size + 4) + c[1] + c[0];
+        if (c[4] == 0 || p + need > file.size()){
+            throw bad();
+        }
+        vector<int32_t> type_offsets(c[4]);
+        size_t types_at = p + c[3] * time_size + c[3];
+        for (int k = 0; k < c[4]; ++k){
+            type_offsets[k] = read_be(&file[types_at + 6 * k], 4);
+        }
+        initial_offset = type_offsets[0];
+        transitions.resize(c[3]);
+        offsets.resize(c[3]);
+        for (int k = 0; k < c[3]; ++k){
+            transitions[k] = read_be(&file[p + k * time_size], time_size);
+            int type = file[p + c[3] * time_size + k];
+            if (type >= c[4])
+                throw bad();
+            offsets[k] = type_offsets[type];
+        }
+        if (time_size == 8){
+            size_t footer = p + need;
+            if (footer < file.size() && file[footer] == '\n'){
+                size_t end = footer + 1;
+                while (end < file.size() && file[end] != '\n'){
+                    end++;
+                }
+                parse_footer(string(file.begin() + footer + 1, file.begin() + end));
+            }
+        }
+    }
+
+    TimeZone() : zone_name("UTC") {}
+
+    // Пояс только из правила POSIX TZ ("UTC-3", "EST5EDT,M3.2.0,M11.1.0"), без файла
+    explicit TimeZone(const string& rule) : zone_name(rule){
+        parse_footer(rule);
+    }
+
+    static const TimeZone& load(const string& name, const string& path);
+
+public:
+    /* Пояс по имени из базы IANA ("Europe/Moscow", "UTC", ...).
+    Первый вызов читает файл, дальше возвращается тот же объект; объекты живут
+    до конца программы, поэтому ссылку можно хранить где угодно */
+    static const TimeZone& get(const string& name);
+
+    static const TimeZone& utc(){
+        static const TimeZone zone;
+        return zone;
+    }
+
+    /* Пояс процесса, как его выбирает localtime() в glibc: без TZ - /etc/localtime,
+    пустая TZ - UTC, иначе файл пояса (с ':' в начале или без): абсолютный путь
+    читается как есть, остальное - имя в базе; если такого файла нет - правило POSIX TZ. Правило с летним временем, но без
+    дат перехода ("EST5EDT"), и всё, что не удалось разобрать, дают UTC */
+    static const TimeZone& local();
+
+    const string& name() const{
+        return zone_name;
+    }
+
+    // Смещение от UTC (секунды) в момент utc
+    int32_t offset_at(int64_t utc) const{
+        if (transitions.empty() || utc >= transitions.back()){
+            if (has_rule)
+                return rule_offset(utc);
+            return transitions.empty() ? initial_offset : offsets.back();
+        }
+        auto it = upper_bound(transitions.begin(), transitions.end(), utc);
+        if (it == transitions.begin())
+            return initial_offset;
+        return offsets[it - transitions.begin() - 1];
+    }
+
+    /* Местное время -> UTC. Для несуществующего времени (переход на летнее)
+    и повторяющегося (переход обратно) берётся смещение до перехода */
+    int64_t to_utc(int64_t local) const{
+        int32_t before = offset_at(local - 86400);
+        int32_t after = offset_at(local + 86400);
+        if (offset_at(local - before) == before)
+            return local - before;
+        if (offset_at(local - after) == after)
+            return local - after;
+        return local - before;
+    }
+};
+
+
 class DateTime{
 private:
-    struct tm dateInfo;
-    string to_string(tm& other){
-        char buffer[80];
-        strftime(buffer, 80, "%d %B %Y, %A", &other);
-        return string(buffer);
+    /* Дата хранится одним числом - номером дня от 1 января 1970 года.
+    Прибавление дней и разница дат - обычная целочисленная арифметика,
+    без mktime/localtime (они берут глобальную блокировку часового пояса,
+    а localtime ещё и возвращает общий статический буфер) */
+    int days;
+    const TimeZone* tz = nullptr;   // nullptr - UTC
+
+    /* Год, месяц, день и день недели считаются один раз при установке даты,
+    чтобы геттеры, сравнения и форматирование их не пересчитывали */
+    int cached_year = 1970;
+    unsigned char cached_month = 1, cached_day = 1, cached_weekday = 4;
+
+    void set_days(int serial){
+        int y, m, d;
+        civil_from_days(serial, y, m, d);
+        days = serial;
+        cached_year = y;
+        cached_month = m;
+        cached_day = d;
+        cached_weekday = weekday_from_days(serial);
+    }
+
+    DateTime(int serial, const TimeZone* zone) : tz(zone){
+        set_days(serial);
+    }
+
+    static constexpr const char* MONTHS[12] = {
+        "January", "February", "March", "April", "May", "June",
+        "July", "August", "September", "October", "November", "December"
+    };
+    static constexpr const char* WEEKDAYS[7] = {
+        "Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"
+    };
+
+    // Запись числа с ведущими нулями до width цифр, возвращает конец записи
+    static char* write_number(char* p, int value, int width){
+        if (value < 0){
+            *p++ = '-';
+            value = -value;
+        }
+        char digits[12];
+        int n = 0;
+        do{
+            digits[n++] = '0' + value % 10;
+            value /= 10;
+        } while (value > 0);
+        while (n < width){
+            digits[n++] = '0';
+        }
+        while (n > 0){
+            *p++ = digits[--n];
+        }
+        return p;
+    }
+
+    // Сравнение слова со строкой таблицы без учёта регистра: полное имя или три буквы
+    static bool match_name(const char* s, size_t len, const char* name){
+        size_t n = 0;
+        while (name[n] && n < len && (s[n] | 0x20) == (name[n] | 0x20)){
+            n++;
+        }
+        return n == len && (name[n] == '\0' || n == 3);
+    }
+
+    // Ищет слово из букв в таблице, возвращает индекс или -1; pos сдвигается за слово
+    static int read_name(const char* s, size_t len, size_t& pos, const char* const* table, int size){
+        size_t start = pos;
+        while (pos < len && ((s[pos] | 0x20) >= 'a' && (s[pos] | 0x20) <= 'z')){
+            pos++;
+        }
+        for (int i = 0; i < size; ++i){
+            if (match_name(s + start, pos - start, table[i]))
+                return i;
+        }
+        return -1;
+    }
+
+    // Читает до max_digits цифр, возвращает количество прочитанных
+    static int read_number(const char* s, size_t len, size_t& pos, int max_digits, int& value){
+        int n = 0;
+        value = 0;
+        while (pos < len && n < max_digits && s[pos] >= '0' && s[pos] <= '9'){
+            value = value * 10 + (s[pos] - '0');
+            pos++;
+            n++;
+        }
+        return n;
+    }
+
+    static void skip_spaces(const char* s, size_t len, size_t& pos){
+        while (pos < len && s[pos] == ' '){
+            pos++;
+        }
+    }
+
+    string to_string(int serial) const{
+        char buffer[FORMAT_SIZE];
+        size_t n = format_days(serial, buffer, FORMAT_SIZE);
+        return string(buffer, n);
     }
 
 public:
+    // Размер буфера, которого всегда хватает для format()
+    static const size_t FORMAT_SIZE = 48;
+
+    /* Поддерживаемые годы: [-MAX_YEAR, MAX_YEAR]. Номер дня для них и
+    промежуточные значения в days_from_civil/civil_from_days помещаются в int;
+    parse и parse_iso отвечают BadYear на годы вне диапазона, а всё, что
+    format и format_iso пишут для таких дат, читается обратно */
+    static const int MAX_YEAR = 5000000;
+
+    // Ошибки разбора строки с датой
+    enum ParseError { Ok, BadDay, BadMonth, BadYear, BadWeekday, WeekdayMismatch, BadFormat };
+
+    static const char* error_message(ParseError error){
+        switch (error){
+            case Ok:              return "ok";
+            case BadDay:          return "day is missing or out of range for the month";
+            case BadMonth:        return "unknown month";
+            case BadYear:         return "year is missing or out of range";
+            case BadWeekday:      return "unknown weekday";
+            case WeekdayMismatch: return "weekday does not match the date";
+            default:              return "unexpected characters";
+        }
+    }
+
+    static int days_in_month(int y, int m){
+        static const unsigned char LENGTHS[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+        return m == 2 && leap ? 29 : LENGTHS[m - 1];
+    }
+
+    /* Дата serial в формате "07 November 2018, Wednesday" (как "%d %B %Y, %A"
+    в локали C) в буфер вызывающего. Возвращает длину без '\0'
+    или 0, если буфер меньше FORMAT_SIZE */
+    static size_t format_days(int serial, char* buffer, size_t size){
+        int y, m, d;
+        civil_from_days(serial, y, m, d);
+        return format_civil(y, m, d, weekday_from_days(serial), buffer, size);
+    }
+
+    static size_t format_civil(int y, int m, int d, int w, char* buffer, size_t size){
+        if (size < FORMAT_SIZE)
+            return 0;
+        char* p = write_number(buffer, d, 2);
+        *p++ = ' ';
+        for (const char* c = MONTHS[m - 1]; *c; ++c){
+            *p++ = *c;
+        }
+        *p++ = ' ';
+        p = write_number(p, y, 1);
+        *p++ = ',';
+        *p++ = ' ';
+        for (const char* c = WEEKDAYS[w]; *c; ++c){
+            *p++ = *c;
+        }
+        *p = '\0';
+        return p - buffer;
+    }
+
+    // Дата serial в формате ISO-8601 "2018-11-07"
+    static size_t format_days_iso(int serial, char* buffer, size_t size){
+        int y, m, d;
+        civil_from_days(serial, y, m, d);
+        return format_civil_iso(y, m, d, buffer, size);
+    }
+
+    static size_t format_civil_iso(int y, int m, int d, char* buffer, size_t size){
+        if (size < FORMAT_SIZE)
+            return 0;
+        char* p = write_number(buffer, y, 4);
+        *p++ = '-';
+        p = write_number(p, m, 2);
+        *p++ = '-';
+        p = write_number(p, d, 2);
+        *p = '\0';
+        return p - buffer;
+    }
+
+    size_t format(char* buffer, size_t size) const{
+        return format_civil(cached_year, cached_month, cached_day, cached_weekday, buffer, size);
+    }
+
+    size_t format_iso(char* buffer, size_t size) const{
+        return format_civil_iso(cached_year, cached_month, cached_day, buffer, size);
+    }
+
+    /* Разбор строки вида "22 january 2024, monday" без выделения памяти.
+    Регистр не важен, месяц и день недели можно сокращать до трёх букв,
+    день недели можно опустить, но если он есть - он должен совпадать с датой.
+    При ошибке out не меняется */
+    static ParseError parse(const char* s, size_t len, DateTime& out){
+        size_t pos = 0;
+        int d, y;
+        skip_spaces(s, len, pos);
+        if (read_number(s, len, pos, 2, d) == 0)
+            return BadDay;
+        skip_spaces(s, len, pos);
+        int m = read_name(s, len, pos, MONTHS, 12) + 1;
+        if (m == 0)
+            return BadMonth;
+        skip_spaces(s, len, pos);
+        bool negative = pos < len && s[pos] == '-';
+        if (negative)
+            pos++;
+        if (read_number(s, len, pos, 9, y) == 0 || y > MAX_YEAR || (pos < len && s[pos] >= '0' && s[pos] <= '9'))
+            return BadYear;
+        if (negative)
+            y = -y;
+        if (d < 1 || d > days_in_month(y, m))
+            return BadDay;
+        int serial = days_from_civil(y, m, d);
+        skip_spaces(s, len, pos);
+        if (pos < len && s[pos] == ','){
+            pos++;
+            skip_spaces(s, len, pos);
+            int w = read_name(s, len, pos, WEEKDAYS, 7);
+            if (w < 0)
+                return BadWeekday;
+            if (w != weekday_from_days(serial))
+                return WeekdayMismatch;
+            skip_spaces(s, len, pos);
+        }
+        if (pos != len)
+            return BadFormat;
+        out.set_days(serial);
+        return Ok;
+    }
+
+    /* Похожа ли строка на ISO-8601: необязательный минус, не меньше четырёх
+    цифр года и сразу '-' (в "07 November 2018" после дня идёт пробел) */
+    static bool is_iso(const char* s, size_t len){
+        size_t pos = len > 0 && s[0] == '-' ? 1 : 0;
+        size_t start = pos;
+        while (pos < len && s[pos] >= '0' && s[pos] <= '9'){
+            pos++;
+        }
+        return pos - start >= 4 && pos < len && s[pos] == '-';
+    }
+
+    /* Разбор даты ISO-8601 "YYYY-MM-DD". Год - не меньше четырёх цифр
+    и может быть отрицательным, как его пишет format_iso ("-0044-03-15", "12345-01-01") */
+    static ParseError parse_iso(const char* s, size_t len, DateTime& out){
+        size_t pos = 0;
+        int y, m, d;
+        bool negative = len > 0 && s[0] == '-';
+        if (negative)
+            pos++;
+        if (read_number(s, len, pos, 9, y) < 4 || y > MAX_YEAR || (pos < len && s[pos] >= '0' && s[pos] <= '9'))
+            return BadYear;
+        if (negative)
+            y = -y;
+        if (pos >= len || s[pos++] != '-')
+            return BadFormat;
+        if (read_number(s, len, pos, 2, m) != 2 || m < 1 || m > 12)
+            return BadMonth;
+        if (pos >= len || s[pos++] != '-')
+            return BadFormat;
+        if (read_number(s, len, pos, 2, d) != 2 || d < 1 || d > days_in_month(y, m))
+            return BadDay;
+        if (pos != len)
+            return BadFormat;
+        out.set_days(days_from_civil(y, m, d));
+        return Ok;
+    }
+
+    /* Номер дня по дате григорианского календаря (month 1..12).
+    Год считается с марта, тогда февраль последний и високосный день
+    попадает в конец года; 400 лет = 146097 дней */
+    static int days_from_civil(int y, int m, int d){
+        y -= m <= 2;
+        int era = (y >= 0 ? y : y - 399) / 400;
+        int yoe = y - era * 400;                                    // [0, 399]
+        int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;   // [0, 365]
+        int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;            // [0, 146096]
+        return era * 146097 + doe - 719468;
+    }
+
+    // Обратное преобразование: номер дня -> год, месяц (1..12), день
+    static void civil_from_days(int z, int& y, int& m, int& d){
+        z += 719468;
+        int era = (z >= 0 ? z : z - 146096) / 146097;
+        int doe = z - era * 146097;                                      // [0, 146096]
+        int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365; // [0, 399]
+        int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);               // [0, 365]
+        int mp = (5 * doy + 2) / 153;                                    // [0, 11]
+        d = doy - (153 * mp + 2) / 5 + 1;
+        m = mp < 10 ? mp + 3 : mp - 9;
+        y = yoe + era * 400 + (m <= 2);
+    }
+
+    // День недели: 0 - воскресенье, ..., 6 - суббота (1 января 1970 - четверг)
+    static int weekday_from_days(int z){
+        return z >= -4 ? (z + 4) % 7 : (z + 5) % 7 + 6;
+    }
+
     // Конструктор с тремя числовыми параметрами (день, месяц, год)
     DateTime(int day, int month, int year){
-        dateInfo = tm();
-        dateInfo.tm_year = year - 1900;
-        dateInfo.tm_mon = month - 1;
-        dateInfo.tm_mday = day;
+        // Месяц вне 1..12 переносится на соседние годы, как это делал mktime
+        year += (month - 1 >= 0 ? (month - 1) / 12 : (month - 12) / 12);
+        month = ((month - 1) % 12 + 12) % 12 + 1;
+        set_days(days_from_civil(year, month, day));
     }
 
-    // Конструктор из строки (в формате "22 january 2024, monday")
+    /* Конструктор из строки (в формате "22 january 2024, monday"
+    или ISO-8601 "2024-01-22"). Неверная строка - исключение invalid_argument */
     DateTime(const string& dateStr){
-        dateInfo = tm();
-        strptime(dateStr.c_str(), "%d %B %Y, %A", &dateInfo);
+        bool iso = is_iso(dateStr.data(), dateStr.size());
+        ParseError error = iso ? parse_iso(dateStr.data(), dateStr.size(), *this)
+                               : parse(dateStr.data(), dateStr.size(), *this);
+        if (error != Ok){
+            throw invalid_argument("DateTime: cannot parse \"" + dateStr + "\": " + error_message(error));
+        }
     }
 
-    // Конструктор без параметров (объект использует текущую дату)
-    DateTime(){
-        time_t now = time(0);
-        dateInfo = *localtime(&now);
-    }
+    // Конструктор без параметров (объект использует текущую дату в поясе процесса)
+    DateTime();
+
+    // Текущая дата в поясе zone
+    DateTime(const TimeZone& zone);
 
     // Конструктор копирования (создаём копию другого объекта)
-    DateTime(const DateTime& other){
-        dateInfo = other.dateInfo;
+    DateTime(const DateTime& other) = default;
+    DateTime& operator=(const DateTime& other) = default;
+
+    // Дата в поясе zone для момента utc (секунды от 1970 года)
+    static DateTime from_epoch(int64_t utc, const TimeZone& zone);
+
+    // Пояс даты (UTC, если дата построена без пояса)
+    const TimeZone& zone() const;
+
+    // Начало суток этой даты в её поясе, секунды UTC
+    int64_t start_of_day() const;
+
+    /* Секунды от начала этих суток до начала суток other.
+    В отличие от умножения дней на 86400, учитывает переходы на летнее время */
+    int64_t seconds_until(const DateTime& other) const{
+        return other.start_of_day() - start_of_day();
+    }
+
+    // Дата по номеру дня от 1 января 1970 года
+    static DateTime from_days(int serial){
+        return DateTime(serial, nullptr);
+    }
+
+    // Номер дня от 1 января 1970 года
+    int serial() const{
+        return days;
+    }
+
+    // Части даты без вычислений и выделения памяти
+    int year() const{
+        return cached_year;
+    }
+
+    int month() const{
+        return cached_month;
+    }
+
+    int day() const{
+        return cached_day;
+    }
+
+    // День недели: 0 - воскресенье, ..., 6 - суббота
+    int weekday() const{
+        return cached_weekday;
+    }
+
+    // Продолжительность в днях: (b - a).count() - число дней от a до b со знаком
+    using Days = chrono::duration<int, ratio<86400>>;
+
+    Days operator-(const DateTime& other) const{
+        return Days(days - other.days);
+    }
+
+    DateTime operator+(Days shift) const{
+        return DateTime(days + shift.count(), tz);
+    }
+
+    DateTime operator-(Days shift) const{
+        return *this + Days(-shift.count());
+    }
+
+    // Сравнение только по дате (пояс не учитывается)
+    bool operator==(const DateTime& other) const{
+        return days == other.days;
+    }
+
+    bool operator!=(const DateTime& other) const{
+        return days != other.days;
+    }
+
+    bool operator<(const DateTime& other) const{
+        return days < other.days;
+    }
+
+    bool operator<=(const DateTime& other) const{
+        return days <= other.days;
+    }
+
+    bool operator>(const DateTime& other) const{
+        return days > other.days;
+    }
+
+    bool operator>=(const DateTime& other) const{
+        return days >= other.days;
     }
 
 
     /*Возвращение текущей даты в виде строки, с указанием дня 
     недели и названия месяца (например 07 november 2018, wednesday)*/
    string get_today(){
-        return to_string(dateInfo);
+        char buffer[FORMAT_SIZE];
+        return string(buffer, format(buffer, FORMAT_SIZE));
     }
 
     // Возвращение даты вчерашнего дня в виде строки
     string get_yesterday(){
-        time_t yesterday = mktime(&dateInfo) - 86400;
-        tm result = *localtime(&yesterday);
-        return to_string(result);
+        return to_string(days - 1);
     }
 
     // Возвращение даты завтрашнего дня в виде строки
     string get_tomorrow(){
-        time_t tomorrow = mktime(&dateInfo) + 86400;
-        tm result = *localtime(&tomorrow);
-        return to_string(result);
+        return to_string(days + 1);
     }
 
     // Возвращение даты через N дней в будущем
     string get_future(unsigned int N){
-        time_t future = mktime(&dateInfo) + N * 86400;
-        tm result = *localtime(&future);
-        return to_string(result);
+        return to_string(days + (int)N);
     }
 
     // Возвращение даты через N дней в прошлом
     string get_past(unsigned int N){
-        time_t past = mktime(&dateInfo) - N * 86400;
-        tm result = *localtime(&past);
-        return to_string(result);
+        return to_string(days - (int)N);
     }
 
     // Для расчёта разницы (в днях) между двумя датами
-    int get_difference(DateTime& other){
-        tm firstDate = tm();
-        firstDate.tm_mday = dateInfo.tm_mday;
-        firstDate.tm_mon = dateInfo.tm_mon;
-        firstDate.tm_year = dateInfo.tm_year;
-        tm secondDate = tm();
-        secondDate.tm_mday = other.dateInfo.tm_mday;
-        secondDate.tm_mon = other.dateInfo.tm_mon;
-        secondDate.tm_year = other.dateInfo.tm_year;
-
-        time_t t1 = mktime(&firstDate);
-        time_t t2 = mktime(&secondDate);
-        double seconds = 0;
-        if (t1 > t2)
-            seconds = difftime(t1, t2);
-        else
-            seconds = difftime(t2, t1);
-
-        return seconds / 86400;
+    int get_difference(const DateTime& other) const{
+        return days > other.days ? days - other.days : other.days - days;
+    }
+};
+
+
+// Определения TimeZone, которым нужен календарь DateTime
+
+inline int64_t TimeZone::rule_local_time(const RuleDate& date, int year){
+    int64_t day;
+    int first = DateTime::days_from_civil(year, 1, 1);
+    if (date.kind == RuleDate::MONTH){
+        int month_start = DateTime::days_from_civil(year, date.month, 1);
+        int shift = (date.weekday - DateTime::weekday_from_days(month_start) + 7) % 7;
+        day = month_start + shift + (date.week - 1) * 7;
+        // Неделя 5 означает "последний такой день месяца"
+        while (day >= month_start + DateTime::days_in_month(year, date.month)){
+            day -= 7;
+        }
+    }
+    else if (date.kind == RuleDate::JULIAN){
+        day = first + date.day - 1;
+        if (DateTime::days_in_month(year, 2) == 29 && date.day >= 60)
+            day++;
+    }
+    else{
+        day = first + date.day;
+    }
+    return day * 86400 + date.time;
+}
+
+inline int32_t TimeZone::rule_offset(int64_t utc) const{
+    if (!has_dst)
+        return std_offset;
+    int64_t local = utc + std_offset;
+    int y, m, d;
+    DateTime::civil_from_days(local >= 0 ? local / 86400 : (local - 86399) / 86400, y, m, d);
+    // Начало летнего времени задано по стандартному времени, конец - по летнему
+    int64_t start = rule_local_time(dst_start, y) - std_offset;
+    int64_t end = rule_local_time(dst_end, y) - dst_offset;
+    if (start < end)
+        return utc >= start && utc < end ? dst_offset : std_offset;
+    return utc >= end && utc < start ? std_offset : dst_offset;
+}
+
+inline const TimeZone& TimeZone::load(const string& name, const string& path){
+    static mutex mtx;
+    static map<string, unique_ptr<TimeZone>> cache;
+    lock_guard<mutex> lock(mtx);
+    auto it = cache.find(path);
+    if (it != cache.end())
+        return *it->second;
+    ifstream in(path, ios::binary);
+    if (!in){
+        throw runtime_error("TimeZone: cannot open " + path);
+    }
+    vector<unsigned char> file((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    unique_ptr<TimeZone> zone(new TimeZone(name, file));
+    const TimeZone& result = *zone;
+    cache[path] = move(zone);
+    return result;
+}
+
+inline const TimeZone& TimeZone::get(const string& name){
+    if (name.empty() || name[0] == '/' || name.find("..") != string::npos){
+        throw invalid_argument("TimeZone: bad zone name \"" + name + "\"");
+    }
+    const char* dir = getenv("TZDIR");
+    return load(name, string(dir && *dir ? dir : "/usr/share/zoneinfo") + "/" + name);
+}
+
+inline const TimeZone& TimeZone::local(){
+    static const TimeZone& zone = []() -> const TimeZone&{
+        const char* tz = getenv("TZ");
+        if (tz && !*tz)
+            return utc();
+        string name = tz ? (tz[0] == ':' ? tz + 1 : tz) : "";
+        try{
+            if (!tz)
+                return load("localtime", "/etc/localtime");
+            // Проверка '/' и ".." в get относится к именам внутри TZDIR, путь задан явно
+            if (name[0] == '/')
+                return load(name, name);
+            return get(name);
+        }
+        catch (exception&){
+            if (!tz)
+                return utc();
+        }
+        static const TimeZone rule(name);
+        return rule.has_rule ? rule : utc();
+    }();
+    return zone;
+}
+
+inline DateTime DateTime::from_epoch(int64_t utc, const TimeZone& zone){
+    int64_t local = utc + zone.offset_at(utc);
+    return DateTime(int(local >= 0 ? local / 86400 : (local - 86399) / 86400), &zone);
+}
+
+inline DateTime::DateTime(const TimeZone& zone) : DateTime(from_epoch(time(0), zone)) {}
+
+inline DateTime::DateTime() : DateTime(TimeZone::local()) {}
+
+inline const TimeZone& DateTime::zone() const{
+    return tz ? *tz : TimeZone::utc();
+}
+
+inline int64_t DateTime::start_of_day() const{
+    return zone().to_utc((int64_t)days * 86400);
+}
+
+
+/* Столбец дат: номера дней от 1 января 1970 года подряд в памяти (int32).
+Все операции - простые циклы без ветвлений по массиву int32, которые
+компилятор векторизует (сборка с -O3 -march=native), а большие столбцы
+дополнительно делятся на куски между потоками */
+class DateColumn{
+private:
+    vector<int32_t> days;
+
+    // Вызывает body(begin, end) для кусков [0, n), по куску на поток
+    template<class F>
+    static void parallel_for(size_t n, F body){
+        const size_t MIN_CHUNK = 1 << 16;
+        size_t threads = min<size_t>(max(1u, thread::hardware_concurrency()), (n + MIN_CHUNK - 1) / MIN_CHUNK);
+        if (threads <= 1){
+            body(size_t(0), n);
+            return;
+        }
+        vector<thread> workers;
+        size_t chunk = (n + threads - 1) / threads;
+        for (size_t t = 0; t < threads; ++t){
+            size_t begin = t * chunk, end = min(n, begin + chunk);
+            workers.emplace_back([=]{ body(begin, end); });
+        }
+        for (auto& worker : workers){
+            worker.join();
+        }
+    }
+
+    /* civil_from_days для одного поля: 0 - год, 1 - месяц, 2 - день.
+    Те же формулы, что в DateTime, но только на int32 и тернарных операторах,
+    которые превращаются в векторные select */
+    template<int FIELD>
+    static inline int32_t civil_field(int32_t z){
+        z += 719468;
+        int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+        int32_t doe = z - era * 146097;
+        int32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        int32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        int32_t mp = (5 * doy + 2) / 153;
+        int32_t d = doy - (153 * mp + 2) / 5 + 1;
+        int32_t m = mp < 10 ? mp + 3 : mp - 9;
+        int32_t y = yoe + era * 400 + (m <= 2);
+        return FIELD == 0 ? y : FIELD == 1 ? m : d;
+    }
+
+    template<int FIELD>
+    vector<int32_t> extract() const{
+        vector<int32_t> result(days.size());
+        const int32_t* src = days.data();
+        int32_t* dst = result.data();
+        parallel_for(days.size(), [=](size_t begin, size_t end){
+            for (size_t i = begin; i < end; ++i){
+                dst[i] = civil_field<FIELD>(src[i]);
+            }
+        });
+        return result;
+    }
+
+    static DateTime::ParseError parse_one(const string& s, DateTime& date){
+        bool iso = DateTime::is_iso(s.data(), s.size());
+        return iso ? DateTime::parse_iso(s.data(), s.size(), date) : DateTime::parse(s.data(), s.size(), date);
+    }
+
+public:
+    DateColumn() {}
+
+    explicit DateColumn(vector<int32_t> serials) : days(move(serials)) {}
+
+    DateColumn(const vector<DateTime>& dates) : days(dates.size()){
+        for (size_t i = 0; i < dates.size(); ++i){
+            days[i] = dates[i].serial();
+        }
+    }
+
+    size_t size() const{
+        return days.size();
+    }
+
+    const int32_t* data() const{
+        return days.data();
+    }
+
+    DateTime operator[](size_t i) const{
+        return DateTime::from_days(days[i]);
+    }
+
+    // Сдвиг всех дат на n дней (n < 0 - в прошлое)
+    void add_days(int n){
+        int32_t* p = days.data();
+        parallel_for(days.size(), [=](size_t begin, size_t end){
+            for (size_t i = begin; i < end; ++i){
+                p[i] += n;
+            }
+        });
+    }
+
+    // Разница в днях с датами другого столбца того же размера (по модулю, как get_difference)
+    vector<int32_t> difference(const DateColumn& other) const{
+        if (other.size() != size()){
+            throw invalid_argument("DateColumn::difference: columns have different sizes");
+        }
+        vector<int32_t> result(days.size());
+        const int32_t* a = days.data();
+        const int32_t* b = other.days.data();
+        int32_t* dst = result.data();
+        parallel_for(days.size(), [=](size_t begin, size_t end){
+            for (size_t i = begin; i < end; ++i){
+                int32_t diff = a[i] - b[i];
+                dst[i] = diff < 0 ? -diff : diff;
+            }
+        });
+        return result;
+    }
+
+    // Разница в днях с одной датой
+    vector<int32_t> difference(const DateTime& date) const{
+        vector<int32_t> result(days.size());
+        const int32_t* a = days.data();
+        int32_t* dst = result.data();
+        int32_t b = date.serial();
+        parallel_for(days.size(), [=](size_t begin, size_t end){
+            for (size_t i = begin; i < end; ++i){
+                int32_t diff = a[i] - b;
+                dst[i] = diff < 0 ? -diff : diff;
+            }
+        });
+        return result;
+    }
+
+    // День недели: 0 - воскресенье, ..., 6 - суббота
+    vector<int32_t> weekday() const{
+        vector<int32_t> result(days.size());
+        const int32_t* src = days.data();
+        int32_t* dst = result.data();
+        parallel_for(days.size(), [=](size_t begin, size_t end){
+            for (size_t i = begin; i < end; ++i){
+                int32_t w = (src[i] + 4) % 7;
+                dst[i] = w < 0 ? w + 7 : w;
+            }
+        });
+        return result;
+    }
+
+    vector<int32_t> year() const{
+        return extract<0>();
+    }
+
+    vector<int32_t> month() const{
+        return extract<1>();
+    }
+
+    vector<int32_t> day() const{
+        return extract<2>();
+    }
+
+    /* Даты из промежутка [from, to] в исходном порядке.
+    Сначала маска по кускам (векторизуется), затем сжатие */
+    DateColumn filter(const DateTime& from, const DateTime& to) const{
+        int32_t lo = from.serial(), hi = to.serial();
+        vector<uint8_t> mask(days.size());
+        const int32_t* src = days.data();
+        uint8_t* m = mask.data();
+        parallel_for(days.size(), [=](size_t begin, size_t end){
+            for (size_t i = begin; i < end; ++i){
+                m[i] = (src[i] >= lo) & (src[i] <= hi);
+            }
+        });
+        vector<int32_t> result;
+        result.reserve(days.size());
+        for (size_t i = 0; i < days.size(); ++i){
+            if (mask[i])
+                result.push_back(src[i]);
+        }
+        return DateColumn(move(result));
+    }
+
+    /* Разбор строк в формате DateTime ("22 january 2024, monday" или ISO-8601).
+    При ошибке - invalid_argument с номером первой неверной строки */
+    static DateColumn parse(const vector<string>& texts){
+        vector<int32_t> result(texts.size());
+        atomic<bool> failed(false);
+        parallel_for(texts.size(), [&](size_t begin, size_t end){
+            DateTime date = DateTime::from_days(0);
+            for (size_t i = begin; i < end; ++i){
+                if (parse_one(texts[i], date) != DateTime::Ok){
+                    failed = true;
+                    return;
+                }
+                result[i] = date.serial();
+            }
+        });
+        if (failed){
+            DateTime date = DateTime::from_days(0);
+            for (size_t i = 0; i < texts.size(); ++i){
+                DateTime::ParseError error = parse_one(texts[i], date);
+                if (error != DateTime::Ok){
+                    throw invalid_argument("DateColumn::parse: line " + to_string(i) + ": "
+                                           + DateTime::error_message(error));
+                }
+            }
+        }
+        return DateColumn(move(result));
+    }
+
+    // Все даты строками в формате DateTime::get_today()
+    vector<string> format() const{
+        vector<string> result(days.size());
+        parallel_for(days.size(), [&](size_t begin, size_t end){
+            char buffer[DateTime::FORMAT_SIZE];
+            for (size_t i = begin; i < end; ++i){
+                size_t n = DateTime::format_days(days[i], buffer, sizeof(buffer));
+                result[i].assign(buffer, n);
+            }
+        });
+        return result;
     }
 };
 
 
-int main(){
+/* Старый путь через mktime/localtime, оставлен только для сравнения в замерах */
+string legacy_future(tm dateInfo, unsigned int N){
+    time_t future = mktime(&dateInfo) + N * 86400;
+    tm result = *localtime(&future);
+    char buffer[80];
+    strftime(buffer, 80, "%d %B %Y, %A", &result);
+    return string(buffer);
+}
+
+int legacy_difference(const tm& a, const tm& b){
+    tm firstDate = tm();
+    firstDate.tm_mday = a.tm_mday;
+    firstDate.tm_mon = a.tm_mon;
+    firstDate.tm_year = a.tm_year;
+    tm secondDate = tm();
+    secondDate.tm_mday = b.tm_mday;
+    secondDate.tm_mon = b.tm_mon;
+    secondDate.tm_year = b.tm_year;
+    return fabs(difftime(mktime(&firstDate), mktime(&secondDate))) / 86400;
+}
+
+/* Замеры: get_future и get_difference против mktime/localtime.
+Запуск: ./DateTime_finale bench [количество операций] (по умолчанию 1000000) */
+void benchmark(int count){
+    mt19937 generator(42);
+    uniform_int_distribution<int> offset(0, 20000);
+    vector<int> shifts(count);
+    for (int& s : shifts){
+        s = offset(generator);
+    }
+    DateTime base(1, 1, 1990);
+    tm base_tm = tm();
+    base_tm.tm_year = 90;
+    base_tm.tm_mday = 1;
+
+    // Проверка, что оба пути дают одинаковые даты
+    for (int i = 0; i < 1000; ++i){
+        if (base.get_future(shifts[i]) != legacy_future(base_tm, shifts[i])){
+            cout << "Raskhozhdenie dlya sdviga " << shifts[i] << endl;
+            return;
+        }
+    }
+
+    size_t checksum = 0;
+    auto start = chrono::steady_clock::now();
+    for (int s : shifts){
+        checksum += legacy_future(base_tm, s).size();
+    }
+    double t_legacy = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    for (int s : shifts){
+        checksum += base.get_future(s).size();
+    }
+    double t_new = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    for (int s : shifts){
+        tm other = base_tm;
+        other.tm_mday += s;
+        checksum += legacy_difference(base_tm, other);
+    }
+    double t_legacy_diff = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    for (int s : shifts){
+        checksum += base.get_difference(DateTime(1 + s, 1, 1990));
+    }
+    double t_new_diff = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // Форматирование и разбор: strftime/strptime против своих format/parse
+    vector<string> texts(count);
+    char buffer[DateTime::FORMAT_SIZE];
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i){
+        tm other = tm();
+        int y, m, d;
+        DateTime::civil_from_days(shifts[i], y, m, d);
+        other.tm_year = y - 1900;
+        other.tm_mon = m - 1;
+        other.tm_mday = d;
+        other.tm_wday = DateTime::weekday_from_days(shifts[i]);
+        checksum += strftime(buffer, sizeof(buffer), "%d %B %Y, %A", &other);
+        texts[i] = buffer;
+    }
+    double t_strftime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    for (int s : shifts){
+        checksum += DateTime::format_days(s, buffer, sizeof(buffer));
+    }
+    double t_format = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    for (const string& text : texts){
+        tm other = tm();
+        strptime(text.c_str(), "%d %B %Y, %A", &other);
+        checksum += other.tm_mday;
+    }
+    double t_strptime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    DateTime parsed(1, 1, 1970);
+    start = chrono::steady_clock::now();
+    for (const string& text : texts){
+        checksum += DateTime::parse(text.data(), text.size(), parsed);
+        checksum += parsed.get_difference(base);
+    }
+    double t_parse = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "get_future: mktime " << count / t_legacy << " op/s, nomer dnya " << count / t_new << " op/s" << endl;
+    cout << "get_difference: mktime " << count / t_legacy_diff << " op/s, nomer dnya " << count / t_new_diff << " op/s" << endl;
+    cout << "format: strftime " << count / t_strftime << " dat/s, format_days " << count / t_format << " dat/s" << endl;
+    cout << "parse: strptime " << count / t_strptime << " dat/s, parse " << count / t_parse << " dat/s" << endl;
+    cout << "(" << checksum << ")" << endl;
+}
+
+/* Замеры для DateColumn: миллионы дат за вызов против цикла по DateTime.
+Запуск: ./DateTime_finale bench column [количество дат] (по умолчанию 10000000) */
+void benchmark_column(int count){
+    mt19937 generator(42);
+    uniform_int_distribution<int32_t> serial(-100000, 100000);
+    vector<int32_t> serials(count);
+    for (int32_t& s : serials){
+        s = serial(generator);
+    }
+    vector<DateTime> dates;
+    dates.reserve(count);
+    for (int32_t s : serials){
+        dates.push_back(DateTime::from_days(s));
+    }
+    DateColumn column(dates);
+    DateTime pivot(1, 1, 2000);
+    long long checksum = 0;
+
+    auto measure = [&](const char* name, auto body){
+        auto start = chrono::steady_clock::now();
+        body();
+        double t = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << name << ": " << count / t << " dat/s" << endl;
+    };
+
+    measure("DateTime::get_difference", [&]{
+        for (DateTime& d : dates){
+            checksum += d.get_difference(pivot);
+        }
+    });
+    measure("DateColumn::difference", [&]{
+        vector<int32_t> r = column.difference(pivot);
+        checksum += r[count / 2];
+    });
+    measure("DateColumn::add_days", [&]{
+        column.add_days(30);
+        checksum += column.data()[count / 2];
+    });
+    measure("DateColumn::weekday", [&]{
+        vector<int32_t> r = column.weekday();
+        checksum += r[count / 2];
+    });
+    measure("DateColumn::year", [&]{
+        vector<int32_t> r = column.year();
+        checksum += r[count / 2];
+    });
+    measure("DateColumn::month", [&]{
+        vector<int32_t> r = column.month();
+        checksum += r[count / 2];
+    });
+    measure("DateColumn::filter", [&]{
+        DateColumn r = column.filter(DateTime(1, 1, 1990), DateTime(31, 12, 2010));
+        checksum += r.size();
+    });
+    vector<string> texts;
+    measure("DateColumn::format", [&]{
+        texts = column.format();
+        checksum += texts[count / 2].size();
+    });
+    measure("DateColumn::parse", [&]{
+        DateColumn r = DateColumn::parse(texts);
+        checksum += r.data()[count / 2];
+    });
+    cout << "(" << checksum << ")" << endl;
+}
+
+/* Замеры: перевод моментов времени в даты разных поясов из нескольких потоков.
+Для сравнения - localtime_r в поясе процесса (берёт общую блокировку).
+Запуск: ./DateTime_finale bench tz [потоков] [переводов на поток] */
+void benchmark_zones(int threads, int count){
+    vector<string> names = {"Europe/Berlin", "America/New_York", "Asia/Tokyo", "Australia/Sydney", "Europe/Moscow"};
+    vector<const TimeZone*> zones;
+    for (const string& name : names){
+        zones.push_back(&TimeZone::get(name));
+    }
+    atomic<long long> checksum(0);
+
+    auto run = [&](bool libc){
+        vector<thread> workers;
+        auto start = chrono::steady_clock::now();
+        for (int t = 0; t < threads; ++t){
+            workers.emplace_back([&, t]{
+                mt19937_64 generator(t);
+                uniform_int_distribution<int64_t> moment(0, 4102444800LL);
+                long long local_sum = 0;
+                for (int i = 0; i < count; ++i){
+                    time_t utc = moment(generator);
+                    if (libc){
+                        tm result;
+                        localtime_r(&utc, &result);
+                        local_sum += result.tm_mday;
+                    }
+                    else{
+                        local_sum += DateTime::from_epoch(utc, *zones[i % zones.size()]).serial();
+                    }
+                }
+                checksum += local_sum;
+            });
+        }
+        for (auto& worker : workers){
+            worker.join();
+        }
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    };
+
+    double t_libc = run(true);
+    double t_zone = run(false);
+    double total = double(threads) * count;
+    cout << threads << " potokov | localtime_r " << total / t_libc << " perevodov/s | TimeZone "
+         << total / t_zone << " perevodov/s | (" << checksum << ")" << endl;
+}
+
+/* Замеры: сортировка вектора дат и разницы соседних дат.
+Старый способ - сравнение через mktime, как делал get_difference,
+новый - operator< и operator- по сохранённому номеру дня.
+Запуск: ./DateTime_finale bench sort [количество дат] (по умолчанию 200000) */
+void benchmark_sort(int count){
+    mt19937 generator(42);
+    uniform_int_distribution<int> serial(0, 20000);
+    vector<DateTime> dates;
+    vector<tm> legacy;
+    for (int i = 0; i < count; ++i){
+        DateTime d = DateTime::from_days(serial(generator));
+        dates.push_back(d);
+        tm t = tm();
+        t.tm_year = d.year() - 1900;
+        t.tm_mon = d.month() - 1;
+        t.tm_mday = d.day();
+        legacy.push_back(t);
+    }
+
+    long long checksum = 0;
+    auto start = chrono::steady_clock::now();
+    sort(legacy.begin(), legacy.end(), [](tm a, tm b){ return mktime(&a) < mktime(&b); });
+    for (int i = 1; i < count; ++i){
+        checksum += legacy_difference(legacy[i], legacy[i - 1]);
+    }
+    double t_legacy = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    sort(dates.begin(), dates.end());
+    for (int i = 1; i < count; ++i){
+        checksum += (dates[i] - dates[i - 1]).count();
+    }
+    double t_new = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "sortirovka + raznitsy: mktime " << t_legacy << " s, DateTime " << t_new << " s | ("
+         << checksum << ")" << endl;
+}
+
+
+int main(int argc, char* argv[]){
+    // ./DateTime_finale bench [количество] | bench column|sort [количество] | bench tz [потоков] [количество]
+    if (argc > 1 && string(argv[1]) == "bench"){
+        if (argc > 2 && string(argv[2]) == "column"){
+            benchmark_column(argc > 3 ? stoi(argv[3]) : 10000000);
+        }
+        else if (argc > 2 && string(argv[2]) == "sort"){
+            benchmark_sort(argc > 3 ? stoi(argv[3]) : 200000);
+        }
+        else if (argc > 2 && string(argv[2]) == "tz"){
+            int threads = argc > 3 ? stoi(argv[3]) : max(1u, thread::hardware_concurrency());
+            benchmark_zones(threads, argc > 4 ? stoi(argv[4]) : 1000000);
+        }
+        else{
+            benchmark(argc > 2 ? stoi(argv[2]) : 1000000);
+        }
+        return 0;
+    }
+
     DateTime today;
     cout << "Vchera - " << today.get_yesterday() << endl;
     cout << "Segodnya - " << today.get_today() << endl;
@@ -2,12 +2,150 @@
 #include <random>
 #include <sstream>
 #include <string>
+#include <stdexcept>
 #include <iterator>
+#include <vector>
+#include <atomic>
+#include <cmath>
+#include <chrono>
 using namespace std;
 
+/* Политики проверки для Matrix.
+CheckedPolicy бросает исключения с описанием ошибки (индекс вне матрицы,
+несовпадение размеров, деление на ноль, вырожденная матрица).
+UncheckedPolicy не проверяет индексы и ничего не бросает: её пустые функции
+исчезают после инлайнинга, а размеры сравниваются один раз на операцию,
+до циклов, как и раньше (при несовпадении возвращается левый операнд).
+По умолчанию используется UncheckedPolicy, проверки включаются -DMATRIX_CHECKED */
+struct UncheckedPolicy{
+    static void index(int, int, int, int){}
+
+    static bool same_shape(const char*, int r1, int c1, int r2, int c2){
+        return r1 == r2 && c1 == c2;
+    }
+
+    static bool inner(const char*, int c1, int r2){
+        return c1 == r2;
+    }
+
+    static void square(const char*, int, int){}
+
+    static void divisor(double){}
+
+    static void invertible(double){}
+};
+
+struct CheckedPolicy{
+    static string shape(int r, int c){
+        return to_string(r) + "x" + to_string(c);
+    }
+
+    static void index(int i, int j, int rows, int cols){
+        if (i < 1 || i > rows || j < 1 || j > cols){
+            throw out_of_range("Matrix: index (" + to_string(i) + ", " + to_string(j)
+                               + ") is out of range for " + shape(rows, cols) + " matrix");
+        }
+    }
+
+    static bool same_shape(const char* op, int r1, int c1, int r2, int c2){
+        if (r1 != r2 || c1 != c2){
+            throw invalid_argument(string("Matrix::") + op + ": shape mismatch "
+                                   + shape(r1, c1) + " vs " + shape(r2, c2));
+        }
+        return true;
+    }
+
+    static bool inner(const char* op, int c1, int r2){
+        if (c1 != r2){
+            throw invalid_argument(string("Matrix::") + op + ": left operand has " + to_string(c1)
+                                   + " columns, right operand has " + to_string(r2) + " rows");
+        }
+        return true;
+    }
+
+    static void square(const char* op, int rows, int cols){
+        if (rows != cols){
+            throw invalid_argument(string("Matrix::") + op + ": matrix " + shape(rows, cols) + " is not square");
+        }
+    }
+
+    static void divisor(double scalar){
+        if (scalar == 0.0){
+            throw domain_error("Matrix::operator/: division by zero");
+        }
+    }
+
+    static void invertible(double det){
+        if (det == 0.0){
+            throw domain_error("Matrix::reverse: matrix is singular");
+        }
+    }
+};
+
+#ifdef MATRIX_CHECKED
+using MatrixCheck = CheckedPolicy;
+#else
+using MatrixCheck = UncheckedPolicy;
+#endif
+
 class Matrix{
 private:
-    double** data;
+    /* Буфер строк, общий для копий одной матрицы: копия стоит O(1),
+    а буфер освобождается вместе с последней копией. Счётчик ссылок
+    атомарный, поэтому копии можно создавать и уничтожать из разных потоков */
+    struct Storage{
+        atomic<int> refs;
+        double** rows;
+        int count;
+
+        Storage(double** rows, int count) : refs(1), rows(rows), count(count) {}
+
+        ~Storage(){
+            for (int i = 0; i < count; ++i){
+                delete[] rows[i];
+            }
+            delete[] rows;
+        }
+    };
+
+    Storage* storage = nullptr;
+    double** data = nullptr;   // storage->rows, чтобы элементы читались как раньше
+
+    friend class TrackedMatrix;
+
+    void release(){
+        if (storage && storage->refs.fetch_sub(1, memory_order_acq_rel) == 1){
+            delete storage;
+        }
+        storage = nullptr;
+        data = nullptr;
+    }
+
+    void swap_buffers(Matrix& other) noexcept{
+        std::swap(storage, other.storage);
+        std::swap(data, other.data);
+        std::swap(rows, other.rows);
+        std::swap(cols, other.cols);
+    }
+
+    // Копия данных в новую матрицу
+    Matrix clone() const{
+        Matrix result(rows, cols);
+        for (int i = 0; i < rows; ++i){
+            copy(data[i], data[i] + cols, result.data[i]);
+        }
+        return result;
+    }
+
+    /* Копирование при записи: перед записью через неконстантный доступ
+    матрица получает собственный буфер, если делит его с копиями */
+    void detach(){
+        if (storage && storage->refs.load(memory_order_acquire) > 1){
+            Matrix own = clone();
+            swap_buffers(own);
+        }
+    }
+
 public:
     int rows;
     int cols;
@@ -19,20 +157,31 @@ public:
         for (int i = 0; i < rows; i++){
             data[i] = new double[cols];
         }
+        storage = new Storage(data, rows);
     }
 
-    // Конструктор Matrix(const Matrix&) - copy
-    Matrix(const Matrix& other){
-        rows = other.rows;
-        cols = other.cols;
-        data = other.data;
+    // Конструктор Matrix(const Matrix&) - copy, за O(1): буфер общий до первой записи
+    Matrix(const Matrix& other) : storage(other.storage), data(other.data), rows(other.rows), cols(other.cols){
+        if (storage)
+            storage->refs.fetch_add(1, memory_order_relaxed);
     }
 
     // Конструктор Matrix(Matrix&&) - move
-    Matrix(Matrix&& other) noexcept{
-        rows = other.rows;
-        cols = other.cols;
-        data = move(other.data);
+    Matrix(Matrix&& other) noexcept : storage(other.storage), data(other.data), rows(other.rows), cols(other.cols){
+        other.storage = nullptr;
+        other.data = nullptr;
+        other.rows = 0;
+        other.cols = 0;
+    }
+
+    // Присваивание (копированием или перемещением - по аргументу)
+    Matrix& operator=(Matrix other) noexcept{
+        swap_buffers(other);
+        return *this;
+    }
+
+    ~Matrix(){
+        release();
     }
 
     /* Конструктор Matrix(n, m, val) - создает матрицу 
@@ -45,6 +194,7 @@ public:
                 data[i][j] = val;
             }
         }
+        storage = new Storage(data, rows);
     }
 
     /* Конструктор вида (См. std::initializer_list):
@@ -65,6 +215,7 @@ public:
             data[i] = new double[cols];
             copy(it->begin(), it->end(), data[i]);
         }
+        storage = new Storage(data, rows);
     }
 
     // Статические методы:
@@ -110,10 +261,11 @@ public:
         while (getline(ss, token, '[')){
             if (token.empty()) continue;
             double** tmp_matrix = matrix.data;
-            matrix.data = new double* [matrix.rows + 1];
+            matrix.data = new double* [matrix.rows + 1]();
             for (int i = 0; i < matrix.rows; ++i){
                 matrix.data[i] = tmp_matrix[i];
             }
+            delete[] tmp_matrix;
             stringstream row_ss(token);
             matrix.cols = 0;
             while (getline(row_ss, token, ',')){
@@ -126,20 +278,35 @@ public:
                     }
                     matrix.data[matrix.rows][matrix.cols] = val;
                     matrix.cols++;
+                    delete[] tmp_row;
                 }
                 catch (invalid_argument& e){}
             }
             matrix.rows++;
         }
+        matrix.storage = new Storage(matrix.data, matrix.rows);
         return matrix;
     }
 
     // Методы:
-    double operator()(int i, int j) const{
+
+    // Элемент с проверкой по выбранной политике (at<CheckedPolicy> проверяет всегда)
+    template<class Check = MatrixCheck>
+    double at(int i, int j) const{
+        Check::index(i, j, rows, cols);
         return data[i - 1][j - 1];
     }
 
+    double operator()(int i, int j) const{
+        return at<MatrixCheck>(i, j);
+    }
+
+    /* Запись в элемент. Если буфер общий с копиями, сначала отделяется свой.
+    Ссылки и итераторы, взятые до копирования матрицы, пишут в общий буфер,
+    поэтому после копирования их надо получить заново */
     double& operator()(int i, int j){
+        MatrixCheck::index(i, j, rows, cols);
+        detach();
         return data[i - 1][j - 1];
     }
 
@@ -193,10 +360,10 @@ public:
     }
 
     Matrix operator+(const Matrix& other) const{
-        Matrix result(rows, cols);
-        if (rows != other.rows || cols != other.cols){
+        if (!MatrixCheck::same_shape("operator+", rows, cols, other.rows, other.cols)){
             return *this;
         }
+        Matrix result(rows, cols);
         for (int i = 0; i < rows; ++i){
             for (int j = 0; j < cols; ++j){
                 result.data[i][j] = data[i][j] + other.data[i][j];
@@ -206,10 +373,10 @@ public:
     }
 
     Matrix operator-(const Matrix& other) const{
-        Matrix result(rows, cols);
-        if (rows != other.rows || cols != other.cols){
+        if (!MatrixCheck::same_shape("operator-", rows, cols, other.rows, other.cols)){
             return *this;
         }
+        Matrix result(rows, cols);
         for (int i = 0; i < rows; ++i){
             for (int j = 0; j < cols; ++j){
                 result.data[i][j] = data[i][j] - other.data[i][j];
@@ -219,10 +386,10 @@ public:
     }
 
     Matrix operator*(const Matrix& other) const{
-        Matrix result(rows, cols);
-        if (cols != other.rows){
+        if (!MatrixCheck::inner("operator*", cols, other.rows)){
             return *this;
         }
+        Matrix result(rows, other.cols, 0.0);
         for (int i = 0; i < rows; ++i){
             for (int j = 0; j < other.cols; ++j){
                 for (int k = 0; k < cols; ++k){
@@ -274,9 +441,11 @@ public:
     }
 
     Matrix reverse() const{
+        MatrixCheck::square("reverse", rows, cols);
         int m = rows;
         Matrix result(m, m);
         double det = Determ(*this, m);
+        MatrixCheck::invertible(det);
         for (int i = 0; i < m; i++){
             for (int j = 0; j < m; j++){
                 result.data[i][j] = Determ(RemoveColRow(*this, m, m, i, j), m - 1);
@@ -325,11 +494,10 @@ public:
 
     Matrix operator/(double scalar) const{
         Matrix result(rows, cols);
-        if (scalar != 0){
-            for (int i = 0; i < rows; ++i){
-                for (int j = 0; j < cols; ++j){
-                    result.data[i][j] = data[i][j] / scalar;
-                }
+        MatrixCheck::divisor(scalar);
+        for (int i = 0; i < rows; ++i){
+            for (int j = 0; j < cols; ++j){
+                result.data[i][j] = data[i][j] / scalar;
             }
         }
         return result;
@@ -443,16 +611,351 @@ public:
 
     // Методы итераторов
     RowIterator iter_rows(int row_index){
+        detach();
         return RowIterator(data[row_index]);
     }
 
     ColIterator iter_cols(int col_index){
+        detach();
         return ColIterator(data, 0, col_index);
     }
 };
 
 
-int main(){
+/* Матрица с отслеживанием изменений. Хранит A^{-1} и det(A) и при замене
+элемента или строки обновляет их за O(n^2) формулой Шермана-Моррисона
+(A + u v^T)^{-1} = A^{-1} - A^{-1} u v^T A^{-1} / (1 + v^T A^{-1} u)
+и леммой об определителе det(A + u v^T) = det(A) * (1 + v^T A^{-1} u).
+Если знаменатель слишком мал или невязка изменённой строки выросла,
+обратная матрица пересчитывается заново методом Гаусса-Жордана */
+class TrackedMatrix{
+private:
+    Matrix a;
+    Matrix inv;
+    double det = 0.0;
+    int n;
+    bool singular = false;
+    int refactor_count = 0;
+    double tolerance = 1e-10;
+
+    // Полный пересчёт: Гаусс-Жордан с выбором главного элемента по столбцу
+    void refactor(){
+        refactor_count++;
+        Matrix work(n, 2 * n, 0.0);
+        for (int i = 0; i < n; ++i){
+            copy(a.data[i], a.data[i] + n, work.data[i]);
+            work.data[i][n + i] = 1.0;
+        }
+        double** w = work.data;
+        det = 1.0;
+        singular = false;
+        for (int k = 0; k < n; ++k){
+            int pivot = k;
+            for (int i = k + 1; i < n; ++i){
+                if (fabs(w[i][k]) > fabs(w[pivot][k]))
+                    pivot = i;
+            }
+            if (w[pivot][k] == 0.0){
+                det = 0.0;
+                singular = true;
+                return;
+            }
+            if (pivot != k){
+                swap(w[pivot], w[k]);
+                det = -det;
+            }
+            double p = w[k][k];
+            det *= p;
+            for (int j = k; j < 2 * n; ++j){
+                w[k][j] /= p;
+            }
+            for (int i = 0; i < n; ++i){
+                if (i == k || w[i][k] == 0.0)
+                    continue;
+                double f = w[i][k];
+                for (int j = k; j < 2 * n; ++j){
+                    w[i][j] -= f * w[k][j];
+                }
+            }
+        }
+        inv.detach();
+        for (int i = 0; i < n; ++i){
+            copy(w[i] + n, w[i] + 2 * n, inv.data[i]);
+        }
+    }
+
+    /* Обновление после A' = A + e_row * v^T (v - изменение строки row).
+    w = v^T A^{-1}; тогда A'^{-1} = A^{-1} - (A^{-1} e_row) w / (1 + w_row) */
+    void rank_one(int row, const vector<double>& v){
+        // matrix() и reverse() могли раздать копии - им изменения не видны
+        a.detach();
+        inv.detach();
+        for (int j = 0; j < n; ++j){
+            a.data[row][j] += v[j];
+        }
+        if (singular){
+            refactor();
+            return;
+        }
+        vector<double> w(n, 0.0);
+        for (int k = 0; k < n; ++k){
+            if (v[k] == 0.0)
+                continue;
+            const double* ik = inv.data[k];
+            for (int j = 0; j < n; ++j){
+                w[j] += v[k] * ik[j];
+            }
+        }
+        double denom = 1.0 + w[row];
+        if (fabs(denom) < tolerance){
+            refactor();
+            return;
+        }
+        det *= denom;
+        for (int r = 0; r < n; ++r){
+            double f = inv.data[r][row] / denom;
+            if (f == 0.0)
+                continue;
+            double* ir = inv.data[r];
+            for (int j = 0; j < n; ++j){
+                ir[j] -= f * w[j];
+            }
+        }
+        // Проверка: строка row произведения A' * A'^{-1} должна быть e_row
+        double residual = 0.0;
+        vector<double> e(n, 0.0);
+        for (int k = 0; k < n; ++k){
+            double ak = a.data[row][k];
+            const double* ik = inv.data[k];
+            for (int j = 0; j < n; ++j){
+                e[j] += ak * ik[j];
+            }
+        }
+        for (int j = 0; j < n; ++j){
+            residual = max(residual, fabs(e[j] - (j == row ? 1.0 : 0.0)));
+        }
+        if (residual > sqrt(tolerance)){
+            refactor();
+        }
+    }
+
+public:
+    // Ссылка на элемент: присваивание идёт через обновление
+    struct Ref{
+        TrackedMatrix& owner;
+        int i, j;
+        Ref& operator=(double value){
+            owner.set(i, j, value);
+            return *this;
+        }
+        operator double() const{
+            return owner.a.data[i - 1][j - 1];
+        }
+    };
+
+    // Неквадратная матрица - исключение invalid_argument
+    TrackedMatrix(const Matrix& m) : a(m.rows, m.cols), inv(m.rows, m.cols), n(m.rows){
+        if (m.rows != m.cols){
+            throw invalid_argument("TrackedMatrix: matrix is not square");
+        }
+        for (int i = 0; i < n; ++i){
+            copy(m.data[i], m.data[i] + n, a.data[i]);
+        }
+        refactor();
+    }
+
+    // Обращение к элементу по индексу (счет начинается с 1), как у Matrix
+    double operator()(int i, int j) const{
+        MatrixCheck::index(i, j, n, n);
+        return a.data[i - 1][j - 1];
+    }
+
+    Ref operator()(int i, int j){
+        MatrixCheck::index(i, j, n, n);
+        return Ref{*this, i, j};
+    }
+
+    void set(int i, int j, double value){
+        MatrixCheck::index(i, j, n, n);
+        vector<double> v(n, 0.0);
+        v[j - 1] = value - a.data[i - 1][j - 1];
+        if (v[j - 1] != 0.0)
+            rank_one(i - 1, v);
+    }
+
+    // Замена строки i (счет с 1) целиком; строка другой длины - исключение invalid_argument
+    void set_row(int i, const vector<double>& row){
+        MatrixCheck::index(i, 1, n, n);
+        if ((int)row.size() != n){
+            throw invalid_argument("TrackedMatrix::set_row: row must have " + to_string(n) + " elements");
+        }
+        vector<double> v(n);
+        for (int j = 0; j < n; ++j){
+            v[j] = row[j] - a.data[i - 1][j];
+        }
+        rank_one(i - 1, v);
+    }
+
+    double Determ() const{
+        return det;
+    }
+
+    // Обратная матрица (для вырожденной - не определена)
+    const Matrix& reverse() const{
+        return inv;
+    }
+
+    const Matrix& matrix() const{
+        return a;
+    }
+
+    bool is_singular() const{
+        return singular;
+    }
+
+    // Сколько раз пришлось пересчитывать обратную целиком
+    int refactorizations() const{
+        return refactor_count;
+    }
+};
+
+
+/* Замеры: изменение одного элемента и пересчёт Determ и reverse().
+Для n <= 8 сравниваем с пересчётом через алгебраические дополнения,
+для остальных - с полным пересчётом методом Гаусса-Жордана.
+Запуск: ./Iter_finale bench [n1 n2 ...] (по умолчанию 6 8 100 300) */
+void benchmark(const vector<int>& sizes){
+    mt19937 generator(42);
+    uniform_int_distribution<int> index(1, 1);
+    uniform_real_distribution<double> value(-1.0, 1.0);
+    for (int n : sizes){
+        index = uniform_int_distribution<int>(1, n);
+        Matrix A = Matrix::Random(n, n);
+        for (int i = 1; i <= n; ++i){
+            A(i, i) += n;
+        }
+        TrackedMatrix T(A);
+        int updates = n <= 8 ? 20 : 200;
+
+        auto start = chrono::steady_clock::now();
+        for (int k = 0; k < updates; ++k){
+            T(index(generator), index(generator)) = value(generator);
+        }
+        double t_tracked = chrono::duration<double>(chrono::steady_clock::now() - start).count() / updates;
+
+        // Тот же набор изменений, но с пересчётом с нуля
+        const Matrix& M = T.matrix();
+        start = chrono::steady_clock::now();
+        Matrix R = n <= 8 ? M.reverse() : TrackedMatrix(M).reverse();
+        double t_full = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        double error = 0.0;
+        for (int i = 1; i <= n; ++i){
+            for (int j = 1; j <= n; ++j){
+                error = max(error, fabs(T.reverse()(i, j) - R(i, j)));
+            }
+        }
+
+        cout << "n = " << n << " | obnovlenie " << t_tracked << " s | polnyi pereschet " << t_full
+             << " s | oshibka obratnoi " << error
+             << " | perescheta " << T.refactorizations() << endl;
+    }
+}
+
+/* Замеры: копирование при записи против глубоких копий.
+Глубокая копия - m * 1.0: новый буфер и проход по всем элементам, как стоила
+бы каждая копия без общего буфера. Сценарии: передача по значению в функцию,
+которая только читает; копия вектора матриц; копия с последующей записью
+одного элемента (здесь буфер всё равно отделяется).
+Читать нужно через const: неконстантный operator() отделяет буфер и при чтении
+Запуск: ./Iter_finale bench cow [n1 n2 ...] (по умолчанию 10 100 1000) */
+double trace_by_value(const Matrix m){
+    double total = 0.0;
+    for (int i = 1; i <= min(m.rows, m.cols); ++i){
+        total += m(i, i);
+    }
+    return total;
+}
+
+void benchmark_cow(const vector<int>& sizes){
+    auto seconds_since = [](chrono::steady_clock::time_point start){
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    };
+    for (int n : sizes){
+        Matrix A = Matrix::Random(n, n);
+        int repeats = max(10, 20000000 / (n * n));
+        double checksum = 0.0;
+
+        auto start = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; ++r){
+            checksum += trace_by_value(A);
+        }
+        double t_shared = seconds_since(start) / repeats;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; ++r){
+            checksum += trace_by_value(A * 1.0);
+        }
+        double t_deep = seconds_since(start) / repeats;
+        cout << "n = " << n << " | po znacheniyu: obshchii bufer " << t_shared * 1e9 << " ns, glubokaya kopiya "
+             << t_deep * 1e9 << " ns" << endl;
+
+        vector<Matrix> many(100, A);
+        int vector_repeats = max(1, repeats / 100);
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < vector_repeats; ++r){
+            const vector<Matrix> copy_of_many(many);
+            checksum += copy_of_many.back()(1, 1);
+        }
+        t_shared = seconds_since(start) / vector_repeats;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < vector_repeats; ++r){
+            vector<Matrix> copy_of_many;
+            copy_of_many.reserve(many.size());
+            for (const Matrix& m : many){
+                copy_of_many.push_back(m * 1.0);
+            }
+            checksum += copy_of_many.back()(1, 1);
+        }
+        t_deep = seconds_since(start) / vector_repeats;
+        cout << "       | vektor iz 100: obshchii bufer " << t_shared * 1e9 << " ns, glubokie kopii "
+             << t_deep * 1e9 << " ns" << endl;
+
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; ++r){
+            Matrix B = A;
+            B(1, 1) = r;
+            checksum += B(1, 1) + A(1, 1);
+        }
+        t_shared = seconds_since(start) / repeats;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; ++r){
+            Matrix B = A * 1.0;
+            B(1, 1) = r;
+            checksum += B(1, 1) + A(1, 1);
+        }
+        t_deep = seconds_since(start) / repeats;
+        cout << "       | kopiya i zapis: s otdeleniem " << t_shared * 1e9 << " ns, glubokaya kopiya "
+             << t_deep * 1e9 << " ns (" << checksum << ")" << endl;
+    }
+}
+
+
+int main(int argc, char* argv[]){
+    // ./Iter_finale bench [n1 n2 ...] или ./Iter_finale bench cow [n1 n2 ...]
+    if (argc > 1 && string(argv[1]) == "bench"){
+        bool cow = argc > 2 && string(argv[2]) == "cow";
+        vector<int> sizes;
+        for (int i = cow ? 3 : 2; i < argc; ++i){
+            sizes.push_back(stoi(argv[i]));
+        }
+        if (cow){
+            benchmark_cow(sizes.empty() ? vector<int>{10, 100, 1000} : sizes);
+        }
+        else{
+            benchmark(sizes.empty() ? vector<int>{6, 8, 100, 300} : sizes);
+        }
+        return 0;
+    }
+
     string matrix_string;
     //Считывание со строки квадратной матрицы A. Например:
     //[[2, 6, 7], [1, 0, 8], [4, 3, 6]]
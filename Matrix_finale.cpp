@@ -2,356 +2,3377 @@
 #include <random>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <algorithm>
+#include <stdexcept>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <queue>
+#include <deque>
+#include <map>
+#include <tuple>
+#include <limits>
+#include <fstream>
+#include <cstdlib>
+#include <cctype>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 using namespace std;
 
-class Matrix{
-private:
-    double** data;
-public:
-    int rows;
-    int cols;
-    Matrix() : rows(0), cols(0) {}
+/* Политики проверки для Matrix.
+CheckedPolicy бросает исключения с описанием ошибки (индекс вне матрицы,
+несовпадение размеров, деление на ноль, вырожденная матрица).
+UncheckedPolicy не проверяет индексы и ничего не бросает: её пустые функции
+исчезают после инлайнинга, а размеры сравниваются один раз на операцию,
+до циклов, как и раньше (при несовпадении возвращается левый операнд).
+По умолчанию используется UncheckedPolicy, проверки включаются -DMATRIX_CHECKED */
+struct UncheckedPolicy{
+    static void index(int, int, int, int){}
 
-    // Конструктор Matrix(n, m) - создает матрицу размера n x m
-    Matrix(int n, int m) : rows(n), cols(m){
-        data = new double* [rows];
-        for (int i = 0; i < rows; i++){
-            data[i] = new double[cols];
-        }
+    static bool same_shape(const char*, int r1, int c1, int r2, int c2){
+        return r1 == r2 && c1 == c2;
     }
 
-    // Конструктор Matrix(const Matrix&) - copy
-    Matrix(const Matrix& other){
-        rows = other.rows;
-        cols = other.cols;
-        data = other.data;
+    static bool inner(const char*, int c1, int r2){
+        return c1 == r2;
     }
 
-    // Конструктор Matrix(Matrix&&) - move
-    Matrix(Matrix&& other) noexcept{
-        rows = other.rows;
-        cols = other.cols;
-        data = move(other.data);
+    static void square(const char*, int, int){}
+
+    static void divisor(double){}
+
+    static void invertible(double){}
+};
+
+struct CheckedPolicy{
+    static string shape(int r, int c){
+        return to_string(r) + "x" + to_string(c);
     }
 
-    /* Конструктор Matrix(n, m, val) - создает матрицу 
-    размера n x m, заполненную числом val */
-    Matrix(int n, int m, double val) : rows(n), cols(m){
-        data = new double* [rows];
-        for (int i = 0; i < rows; i++){
-            data[i] = new double[cols];
-            for (int j = 0; j < cols; j++){
-                data[i][j] = val;
-            }
+    static void index(int i, int j, int rows, int cols){
+        if (i < 1 || i > rows || j < 1 || j > cols){
+            throw out_of_range("Matrix: index (" + to_string(i) + ", " + to_string(j)
+                               + ") is out of range for " + shape(rows, cols) + " matrix");
         }
     }
 
-    /* Конструктор вида (См. std::initializer_list):
-    Matrix m {
-    { 1, 2, 3 },
-    { 4, 5, 6 },
-    { 7, 8, 9 }
-    }; */
-    Matrix(initializer_list<initializer_list<double>> list){
-        rows = list.size();
-        cols = 0;
-        for (auto& x : list)
-            if (x.size() > cols)
-                cols = x.size();
-        data = new double* [rows];
-        auto it = list.begin();
-        for (int i = 0; i < rows; i++, it++){
-            data[i] = new double[cols];
-            copy(it->begin(), it->end(), data[i]);
+    static bool same_shape(const char* op, int r1, int c1, int r2, int c2){
+        if (r1 != r2 || c1 != c2){
+            throw invalid_argument(string("Matrix::") + op + ": shape mismatch "
+                                   + shape(r1, c1) + " vs " + shape(r2, c2));
         }
+        return true;
     }
 
-    // Статические методы:
+    static bool inner(const char* op, int c1, int r2){
+        if (c1 != r2){
+            throw invalid_argument(string("Matrix::") + op + ": left operand has " + to_string(c1)
+                                   + " columns, right operand has " + to_string(r2) + " rows");
+        }
+        return true;
+    }
 
-    // Identity(n, m) - возвращает матрицу с единицами по диагонали
-    static Matrix Identity(int n, int m){
-        Matrix identity(n, m);
-        for (int i = 0; i < min(n, m); ++i){
-            identity.data[i][i] = 1.0;
+    static void square(const char* op, int rows, int cols){
+        if (rows != cols){
+            throw invalid_argument(string("Matrix::") + op + ": matrix " + shape(rows, cols) + " is not square");
         }
-        return identity;
     }
 
-    // Zero(n, m) - возвращает матрицу, заполненную нулями
-    static Matrix Zero(int n, int m){
-        return Matrix(n, m, 0.0);
+    static void divisor(double scalar){
+        if (scalar == 0.0){
+            throw domain_error("Matrix::operator/: division by zero");
+        }
     }
 
-    /* Random(n, m) - возвращает матрицу, заполненную случайными числами 
-    (см. std::uniform_real_distribution для генерации случайных чисел 
-    с плавающей запятой) */
-    static Matrix Random(int n, int m){
-        Matrix randomMatrix(n, m);
-        random_device rd;
-        mt19937 generator(rd());
-        uniform_real_distribution<double> distribution(0.0, 1.0);
-        for (int i = 0; i < n; ++i){
-            for (int j = 0; j < m; ++j){
-                randomMatrix.data[i][j] = distribution(generator);
+    static void invertible(double det){
+        if (det == 0.0){
+            throw domain_error("Matrix::reverse: matrix is singular");
+        }
+    }
+};
+
+#ifdef MATRIX_CHECKED
+using MatrixCheck = CheckedPolicy;
+#else
+using MatrixCheck = UncheckedPolicy;
+#endif
+
+/* Топология NUMA: узлы памяти и их процессоры. Читается из
+/sys/devices/system/node (только процессоры, доступные процессу).
+Переменная окружения MATRIX_NUMA_NODES=N задаёт N условных узлов, между
+которыми доступные процессоры делятся поровну (если процессоров меньше,
+узлы делят одни и те же) - так всё проверяется и на машине с одним узлом */
+class NumaTopology{
+private:
+    vector<vector<int>> node_cpus;
+    bool is_simulated = false;
+
+    // "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+    static vector<int> parse_list(const string& text){
+        vector<int> result;
+        stringstream ss(text);
+        string item;
+        while (getline(ss, item, ',')){
+            if (item.empty() || !isdigit(item[0]))
+                continue;
+            size_t dash = item.find('-');
+            int first = stoi(item), last = dash == string::npos ? first : stoi(item.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu){
+                result.push_back(cpu);
             }
         }
-        return randomMatrix;
+        return result;
     }
 
-    /* FromString(str) - парсит строку и возвращает матрицу. 
-    Формат как в питончике: [[1, 2, 3], [4, 5, 6], [7, 8, 9]] */
-    static Matrix FromString(const string& str){
-        Matrix matrix;
-        stringstream ss(str);
-        string token;
+    static string read_line(const string& path){
+        ifstream file(path);
+        string line;
+        getline(file, line);
+        return line;
+    }
 
-        matrix.rows = 0;
-        while (getline(ss, token, '[')){
-            if (token.empty()) continue;
-            double** tmp_matrix = matrix.data;
-            matrix.data = new double* [matrix.rows + 1];
-            for (int i = 0; i < matrix.rows; ++i){
-                matrix.data[i] = tmp_matrix[i];
+    NumaTopology(){
+        vector<int> allowed;
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0){
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu){
+                if (CPU_ISSET(cpu, &set))
+                    allowed.push_back(cpu);
             }
-            stringstream row_ss(token);
-            matrix.cols = 0;
-            while (getline(row_ss, token, ',')){
-                try{
-                    double val = stod(token);
-                    double* tmp_row = matrix.data[matrix.rows];
-                    matrix.data[matrix.rows] = new double[matrix.cols + 1];
-                    for (int i = 0; i < matrix.cols; ++i){
-                        matrix.data[matrix.rows][i] = tmp_row[i];
-                    }
-                    matrix.data[matrix.rows][matrix.cols] = val;
-                    matrix.cols++;
+        }
+#endif
+        if (allowed.empty()){
+            for (int cpu = 0; cpu < int(max(1u, thread::hardware_concurrency())); ++cpu){
+                allowed.push_back(cpu);
+            }
+        }
+
+        const char* simulate = getenv("MATRIX_NUMA_NODES");
+        if (simulate && atoi(simulate) > 0){
+            int nodes = atoi(simulate);
+            int count = allowed.size();
+            is_simulated = true;
+            node_cpus.resize(nodes);
+            for (int k = 0; k < nodes; ++k){
+                if (count >= nodes){
+                    node_cpus[k].assign(allowed.begin() + count * k / nodes, allowed.begin() + count * (k + 1) / nodes);
+                }
+                else{
+                    node_cpus[k].push_back(allowed[k % count]);
                 }
-                catch (invalid_argument& e){}
             }
-            matrix.rows++;
+            return;
         }
-        return matrix;
+
+        for (int node : parse_list(read_line("/sys/devices/system/node/online"))){
+            vector<int> cpus;
+            for (int cpu : parse_list(read_line("/sys/devices/system/node/node" + to_string(node) + "/cpulist"))){
+                if (find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+                    cpus.push_back(cpu);
+            }
+            // Узлы без доступных процессоров (только память) пропускаем
+            if (!cpus.empty())
+                node_cpus.push_back(cpus);
+        }
+        if (node_cpus.empty())
+            node_cpus.push_back(allowed);
     }
 
-    // Методы:
-    double operator()(int i, int j) const{
-        return data[i - 1][j - 1];
+public:
+    static const NumaTopology& get(){
+        static NumaTopology topology;
+        return topology;
     }
 
-    bool operator==(const Matrix& other) const{
-        if (rows != other.rows || cols != other.cols){
-            return false;
+    int nodes() const{
+        return node_cpus.size();
+    }
+
+    const vector<int>& cpus(int node) const{
+        return node_cpus[node];
+    }
+
+    bool simulated() const{
+        return is_simulated;
+    }
+
+    int workers() const{
+        int count = 0;
+        for (const auto& cpus : node_cpus){
+            count += cpus.size();
         }
-        for (int i = 0; i < rows; ++i){
-            for (int j = 0; j < cols; ++j){
-                if (data[i][j] != other.data[i][j]){
-                    return false;
-                }
+        return count;
+    }
+
+    /* По потоку на каждый процессор (узлы по порядку), поток закреплён за своим
+    процессором. body(node, index, count, worker): index - номер потока внутри
+    узла, count - число потоков узла, worker - общий номер. only_node >= 0 -
+    запускать только потоки этого узла */
+    template<class F>
+    void run(F body, int only_node = -1) const{
+        vector<thread> threads;
+        int worker = 0;
+        for (int node = 0; node < nodes(); ++node){
+            int count = node_cpus[node].size();
+            for (int index = 0; index < count; ++index, ++worker){
+                if (only_node >= 0 && node != only_node)
+                    continue;
+                int cpu = node_cpus[node][index];
+                threads.emplace_back([=, &body]{
+#ifdef __linux__
+                    cpu_set_t set;
+                    CPU_ZERO(&set);
+                    CPU_SET(cpu, &set);
+                    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+                    body(node, index, count, worker);
+                });
             }
         }
-        return true;
+        for (auto& t : threads){
+            t.join();
+        }
     }
 
-    bool operator!=(const Matrix& other) const{
-        return !(*this == other);
+    /* Строки [0, rows) делятся на куски подряд по всем потокам: body(node, begin, end).
+    Одно и то же разбиение используется при размещении и при вычислениях,
+    поэтому каждый поток работает со строками, которые он сам и записал первым */
+    template<class F>
+    void parallel_rows(int rows, F body) const{
+        int total = workers();
+        run([&](int node, int, int, int worker){
+            int begin = int(long(rows) * worker / total), end = int(long(rows) * (worker + 1) / total);
+            if (begin < end)
+                body(node, begin, end);
+        });
     }
+};
 
+// Как Matrix::Numa размещает строки по узлам
+enum class NumaPlacement{
+    Partitioned,   // кусками подряд, как их делит NumaTopology::parallel_rows
+    Interleaved,   // строка i - на узле i % nodes
+    Single         // все строки на одном узле
+};
 
-    Matrix operator-() const{
-        Matrix result(rows, cols);
-        for (int i = 0; i < rows; ++i){
-            for (int j = 0; j < cols; ++j){
-                result.data[i][j] = -data[i][j];
+// Точность, в которой Matrix::solve раскладывает матрицу
+enum class SolvePrecision{
+    Double,
+    Mixed,
+    Auto    // Mixed, если правых частей не больше n / 4, иначе Double
+};
+
+class Matrix{
+private:
+    /* Буфер строк, общий для копий одной матрицы: копия стоит O(1),
+    а буфер освобождается вместе с последней копией. Счётчик ссылок
+    атомарный, поэтому копии можно создавать и уничтожать из разных потоков */
+    struct Storage{
+        atomic<int> refs;
+        double** rows;
+        int count;
+
+        Storage(double** rows, int count) : refs(1), rows(rows), count(count) {}
+
+        ~Storage(){
+            for (int i = 0; i < count; ++i){
+                delete[] rows[i];
             }
+            delete[] rows;
         }
-        return result;
-    }
+    };
 
-    Matrix transpose() const{
-        Matrix transposed(cols, rows);
-        for (int i = 0; i < rows; ++i){
-            for (int j = 0; j < cols; ++j){
-                transposed.data[j][i] = data[i][j];
+    Storage* storage = nullptr;
+    double** data = nullptr;   // storage->rows, чтобы элементы читались как раньше
+
+    friend class QR;
+    friend class Cholesky;
+
+    /* Блочное умножение C += A * B, где A - n x k, B - k x m.
+    Обход блоками BS x BS, чтобы куски A, B и C помещались в кэш,
+    а внутренний цикл шёл по строкам подряд */
+    static void gemm(double** C, double** A, double** B, int n, int k, int m){
+        const int BS = 64;
+        for (int ii = 0; ii < n; ii += BS){
+            int ie = min(ii + BS, n);
+            for (int kk = 0; kk < k; kk += BS){
+                int ke = min(kk + BS, k);
+                for (int jj = 0; jj < m; jj += BS){
+                    int je = min(jj + BS, m);
+                    for (int i = ii; i < ie; ++i){
+                        double* c = C[i];
+                        for (int p = kk; p < ke; ++p){
+                            double a = A[i][p];
+                            double* b = B[p];
+                            for (int j = jj; j < je; ++j){
+                                c[j] += a * b[j];
+                            }
+                        }
+                    }
+                }
             }
         }
-        return transposed;
     }
 
-    double sum() const{
-        double total = 0.0;
-        for (int i = 0; i < rows; ++i){
-            for (int j = 0; j < cols; ++j){
-                total += data[i][j];
-            }
+    void release(){
+        if (storage && storage->refs.fetch_sub(1, memory_order_acq_rel) == 1){
+            delete storage;
         }
-        return total;
+        storage = nullptr;
+        data = nullptr;
     }
 
-    Matrix operator+(const Matrix& other) const{
+    void swap_buffers(Matrix& other) noexcept{
+        std::swap(storage, other.storage);
+        std::swap(data, other.data);
+        std::swap(rows, other.rows);
+        std::swap(cols, other.cols);
+    }
+
+    // Копия данных в новую матрицу (конструктор копирования только делит буфер)
+    Matrix clone() const{
         Matrix result(rows, cols);
-        if (rows != other.rows || cols != other.cols){
-            return *this;
-        }
         for (int i = 0; i < rows; ++i){
-            for (int j = 0; j < cols; ++j){
-                result.data[i][j] = data[i][j] + other.data[i][j];
-            }
+            copy(data[i], data[i] + cols, result.data[i]);
         }
         return result;
     }
 
-    Matrix operator-(const Matrix& other) const{
-        Matrix result(rows, cols);
-        if (rows != other.rows || cols != other.cols){
-            return *this;
+    /* Копирование при записи: перед записью на месте (Cholesky::update)
+    матрица получает собственный буфер, если делит его с копиями */
+    void detach(){
+        if (storage && storage->refs.load(memory_order_acquire) > 1){
+            Matrix own = clone();
+            swap_buffers(own);
         }
-        for (int i = 0; i < rows; ++i){
-            for (int j = 0; j < cols; ++j){
-                result.data[i][j] = data[i][j] - other.data[i][j];
-            }
+    }
+
+    // C = A * B в уже выделенный буфер C (без новых выделений памяти)
+    static void multiply_into(Matrix& C, const Matrix& A, const Matrix& B){
+        for (int i = 0; i < C.rows; ++i){
+            fill(C.data[i], C.data[i] + C.cols, 0.0);
         }
-        return result;
+        gemm(C.data, A.data, B.data, A.rows, A.cols, B.cols);
     }
 
-    Matrix operator*(const Matrix& other) const{
-        Matrix result(rows, cols);
-        if (cols != other.rows){
-            return *this;
+    // C += a * X
+    static void add_scaled(Matrix& C, double a, const Matrix& X){
+        for (int i = 0; i < C.rows; ++i){
+            for (int j = 0; j < C.cols; ++j){
+                C.data[i][j] += a * X.data[i][j];
+            }
         }
+    }
+
+    // Копирует значения other в уже выделенный буфер того же размера
+    void assign_from(const Matrix& other){
         for (int i = 0; i < rows; ++i){
-            for (int j = 0; j < other.cols; ++j){
-                for (int k = 0; k < cols; ++k){
-                    result.data[i][j] += data[i][k] * other.data[k][j];
+            copy(other.data[i], other.data[i] + cols, data[i]);
+        }
+    }
+
+    /* Решает A X = B на месте: A портится, в B остаётся X.
+    Исключение Гаусса с выбором главного элемента по столбцу; строки
+    переставляются обменом указателей */
+    static void solve_in_place(Matrix& A, Matrix& B){
+        int n = A.rows;
+        for (int k = 0; k < n; ++k){
+            int p = k;
+            for (int i = k + 1; i < n; ++i){
+                if (fabs(A.data[i][k]) > fabs(A.data[p][k]))
+                    p = i;
+            }
+            if (A.data[p][k] == 0.0)
+                throw runtime_error("solve: matrix is singular");
+            std::swap(A.data[k], A.data[p]);
+            std::swap(B.data[k], B.data[p]);
+            for (int i = k + 1; i < n; ++i){
+                double f = A.data[i][k] / A.data[k][k];
+                if (f == 0.0)
+                    continue;
+                for (int j = k + 1; j < n; ++j){
+                    A.data[i][j] -= f * A.data[k][j];
+                }
+                for (int j = 0; j < B.cols; ++j){
+                    B.data[i][j] -= f * B.data[k][j];
                 }
             }
         }
-        return result;
+        for (int k = n - 1; k >= 0; --k){
+            for (int j = 0; j < B.cols; ++j){
+                double s = B.data[k][j];
+                for (int i = k + 1; i < n; ++i){
+                    s -= A.data[k][i] * B.data[i][j];
+                }
+                B.data[k][j] = s / A.data[k][k];
+            }
+        }
     }
 
-    Matrix RemoveColRow(Matrix src, int rows, int cols, int row, int col) const{
-        int di, dj;
-        Matrix result(rows - 1, cols - 1);
-        di = 0;
-        for (int i = 0; i < rows - 1; i++){
-            if (i == row)
-                di = 1;
-            dj = 0;
-            for (int j = 0; j < cols - 1; j++){
-                if (j == col)
-                    dj = 1;
-                result.data[i][j] = src.data[i + di][j + dj];
+    /* LU-разложение с выбором главного элемента по столбцу для плотного
+    буфера n x n по строкам (T = float или double). Строки переставляются
+    целиком, pivot[k] - строка, обменянная с k на шаге k. Возвращает false
+    на нулевом или нечисловом главном элементе */
+    template<class T>
+    static bool lu_factor(T* a, int* pivot, int n){
+        for (int k = 0; k < n; ++k){
+            int p = k;
+            for (int i = k + 1; i < n; ++i){
+                if (fabs(a[size_t(i) * n + k]) > fabs(a[size_t(p) * n + k]))
+                    p = i;
+            }
+            T akk = a[size_t(p) * n + k];
+            if (akk == T(0) || !isfinite(akk))
+                return false;
+            pivot[k] = p;
+            if (p != k)
+                swap_ranges(a + size_t(k) * n, a + size_t(k) * n + n, a + size_t(p) * n);
+            const T* ak = a + size_t(k) * n;
+            T inv = T(1) / akk;
+            for (int i = k + 1; i < n; ++i){
+                T* ai = a + size_t(i) * n;
+                T f = ai[k] * inv;
+                ai[k] = f;
+                if (f == T(0))
+                    continue;
+                for (int j = k + 1; j < n; ++j){
+                    ai[j] -= f * ak[j];
+                }
             }
         }
-        return result;
+        return true;
     }
 
-    double Determ(Matrix src, int m) const{
-        int k = 1;
-        double det = 0;
-        if (m < 1)
-            return 0;
-        if (m == 1){
-            det = src.data[0][0];
-            return det;
+    // Решает LU X = P B на месте для буфера b размера n x m по строкам
+    template<class T>
+    static void lu_solve(const T* lu, const int* pivot, int n, T* b, int m){
+        for (int k = 0; k < n; ++k){
+            if (pivot[k] != k)
+                swap_ranges(b + size_t(k) * m, b + size_t(k) * m + m, b + size_t(pivot[k]) * m);
         }
-        if (m == 2){
-            det = src.data[0][0] * src.data[1][1] - (src.data[1][0] * src.data[0][1]);
-            return det;
+        for (int i = 0; i < n; ++i){
+            T* bi = b + size_t(i) * m;
+            for (int k = 0; k < i; ++k){
+                T f = lu[size_t(i) * n + k];
+                if (f == T(0))
+                    continue;
+                const T* bk = b + size_t(k) * m;
+                for (int j = 0; j < m; ++j){
+                    bi[j] -= f * bk[j];
+                }
+            }
         }
-        if (m > 2){
-            for (int i = 0; i < m; i++){
-                Matrix result = RemoveColRow(src, m, m, i, 0);
-                det = det + k * src.data[i][0] * Determ(result, m - 1);
-                k = -k;
+        for (int i = n - 1; i >= 0; --i){
+            T* bi = b + size_t(i) * m;
+            for (int k = i + 1; k < n; ++k){
+                T f = lu[size_t(i) * n + k];
+                const T* bk = b + size_t(k) * m;
+                for (int j = 0; j < m; ++j){
+                    bi[j] -= f * bk[j];
+                }
+            }
+            T inv = T(1) / lu[size_t(i) * n + i];
+            for (int j = 0; j < m; ++j){
+                bi[j] *= inv;
             }
         }
-        return det;
     }
 
-    Matrix reverse() const{
-        int m = rows;
-        Matrix result(m, m);
-        double det = Determ(*this, m);
-        for (int i = 0; i < m; i++){
-            for (int j = 0; j < m; j++){
-                result.data[i][j] = Determ(RemoveColRow(*this, m, m, i, j), m - 1);
-                if ((i + j) % 2 == 1)
-                    result.data[i][j] = -result.data[i][j];
-                result.data[i][j] = result.data[i][j] / det;
+    /* Смешанная точность: LU во float, затем уточнение X += A^-1 (B - A X),
+    где невязка считается в double. Останавливается, когда для каждого столбца
+    |r| <= sqrt(n) eps |A| |x| (как dsgesv в LAPACK). false - если float
+    не справился (переполнение, нулевой главный элемент, нет сходимости) */
+    bool solve_mixed(const Matrix& B, Matrix& X, int& steps) const{
+        const int MAX_STEPS = 30;
+        int n = rows, m = B.cols;
+        const double float_max = numeric_limits<float>::max();
+        vector<float> lu(size_t(n) * n), r(size_t(n) * m);
+        vector<int> pivot(n);
+        double norm_a = 0.0;
+        for (int i = 0; i < n; ++i){
+            double s = 0.0;
+            for (int j = 0; j < n; ++j){
+                if (fabs(data[i][j]) > float_max)
+                    return false;
+                lu[size_t(i) * n + j] = float(data[i][j]);
+                s += fabs(data[i][j]);
             }
+            norm_a = max(norm_a, s);
         }
-        return result.transpose();
+        for (int i = 0; i < n; ++i){
+            for (int j = 0; j < m; ++j){
+                if (fabs(B.data[i][j]) > float_max)
+                    return false;
+                r[size_t(i) * m + j] = float(B.data[i][j]);
+            }
+        }
+        if (!lu_factor(lu.data(), pivot.data(), n))
+            return false;
+        lu_solve(lu.data(), pivot.data(), n, r.data(), m);
+        for (int i = 0; i < n; ++i){
+            copy(r.begin() + size_t(i) * m, r.begin() + size_t(i) * m + m, X.data[i]);
+        }
+
+        double tolerance = sqrt(double(n)) * numeric_limits<double>::epsilon() * norm_a;
+        Matrix AX(n, m);
+        vector<double> residual_norm(m), x_norm(m);
+        for (steps = 0; ; ++steps){
+            multiply_into(AX, *this, X);
+            fill(residual_norm.begin(), residual_norm.end(), 0.0);
+            fill(x_norm.begin(), x_norm.end(), 0.0);
+            for (int i = 0; i < n; ++i){
+                for (int j = 0; j < m; ++j){
+                    double residual = B.data[i][j] - AX.data[i][j];
+                    AX.data[i][j] = residual;
+                    residual_norm[j] = max(residual_norm[j], fabs(residual));
+                    x_norm[j] = max(x_norm[j], fabs(X.data[i][j]));
+                }
+            }
+            bool converged = true, finite = true;
+            for (int j = 0; j < m; ++j){
+                converged = converged && residual_norm[j] <= x_norm[j] * tolerance;
+                finite = finite && isfinite(residual_norm[j]) && isfinite(x_norm[j]);
+            }
+            if (converged)
+                return true;
+            if (!finite || steps == MAX_STEPS)
+                return false;
+            for (int i = 0; i < n; ++i){
+                for (int j = 0; j < m; ++j){
+                    r[size_t(i) * m + j] = float(AX.data[i][j]);
+                }
+            }
+            lu_solve(lu.data(), pivot.data(), n, r.data(), m);
+            for (int i = 0; i < n; ++i){
+                for (int j = 0; j < m; ++j){
+                    X.data[i][j] += r[size_t(i) * m + j];
+                }
+            }
+        }
+    }
+
+    // Матрица с массивом указателей на строки, но без самих строк
+    static Matrix unallocated(int n, int m){
+        Matrix result;
+        result.rows = n;
+        result.cols = m;
+        result.data = new double* [n]();
+        result.storage = new Storage(result.data, n);
+        return result;
+    }
+
+    // Скалярное произведение двух строк длины n
+    static double dot(const double* a, const double* b, int n){
+        double s = 0.0;
+        for (int k = 0; k < n; ++k){
+            s += a[k] * b[k];
+        }
+        return s;
+    }
+
+    // Указатели на строки блока, начинающегося в (r0, c0), - так gemm работает с частью матрицы
+    static vector<double*> block_rows(double** a, int r0, int c0, int count){
+        vector<double*> result(count);
+        for (int i = 0; i < count; ++i){
+            result[i] = a[r0 + i] + c0;
+        }
+        return result;
+    }
+
+    /* Отражение Хаусхолдера H = I - tau v v^T, переводящее x (len элементов подряд)
+    в (beta, 0, ..., 0). Хвост v (v[0] = 1) записывается на место x[1..],
+    x[0] не меняется. Возвращает beta; tau = 0 означает H = I */
+    static double make_reflector(double* x, int len, double& tau){
+        double norm = 0.0;
+        for (int i = 1; i < len; ++i){
+            norm += x[i] * x[i];
+        }
+        if (norm == 0.0){
+            tau = 0.0;
+            return x[0];
+        }
+        double alpha = x[0];
+        double beta = -copysign(sqrt(alpha * alpha + norm), alpha);
+        tau = (beta - alpha) / beta;
+        double scale = 1.0 / (alpha - beta);
+        for (int i = 1; i < len; ++i){
+            x[i] *= scale;
+        }
+        return beta;
+    }
+
+    /* C = H_0 H_1 ... H_{nb-1} C = (I - V T V^T) C, а при transpose_t - (I - V T^T V^T) C.
+    Vt - nb x len, строка p - вектор отражения H_p (с нулями до его единицы),
+    C - len строк по w элементов. Треугольный T строится как в DLARFT LAPACK,
+    а оба произведения с C идут через gemm */
+    static void apply_reflectors(const Matrix& Vt, const double* tau, double** C, int w, bool transpose_t){
+        int nb = Vt.rows, len = Vt.cols;
+        Matrix T(nb, nb, 0.0);
+        vector<double> z(nb);
+        for (int j = 0; j < nb; ++j){
+            for (int p = 0; p < j; ++p){
+                z[p] = dot(Vt.data[p], Vt.data[j], len);
+            }
+            for (int p = 0; p < j; ++p){
+                double s = 0.0;
+                for (int r = p; r < j; ++r){
+                    s += T.data[p][r] * z[r];
+                }
+                T.data[p][j] = -tau[j] * s;
+            }
+            T.data[j][j] = tau[j];
+        }
+        if (transpose_t){
+            T = T.transpose();
+        }
+        Matrix Y(nb, w, 0.0), TY(nb, w, 0.0), V(len, nb);
+        gemm(Y.data, Vt.data, C, nb, len, w);
+        gemm(TY.data, T.data, Y.data, nb, nb, w);
+        for (int i = 0; i < len; ++i){
+            for (int p = 0; p < nb; ++p){
+                V.data[i][p] = -Vt.data[p][i];
+            }
+        }
+        gemm(C, V.data, TY.data, len, nb, w);
+    }
+
+    /* Явное произведение отражений H_0 H_1 ... H_{count-1}, первые cols столбцов.
+    Вектор H_i лежит в строке i матрицы R: единица в столбце i + shift, дальше хвост.
+    Отражения применяются к единичной матрице блоками по 32 с конца, тогда
+    каждый блок меняет только правый нижний угол */
+    static Matrix reflectors_product(const Matrix& R, const vector<double>& tau, int count, int shift, int cols){
+        const int NB = 32;
+        int n = R.cols;
+        Matrix Q = Identity(n, cols);
+        for (int k0 = (count - 1) / NB * NB; k0 >= 0 && count > 0; k0 -= NB){
+            int nb = min(NB, count - k0), s = k0 + shift;
+            if (s >= cols)
+                continue;
+            Matrix Vt(nb, n - s, 0.0);
+            for (int p = 0; p < nb; ++p){
+                int start = k0 + p + shift;
+                Vt.data[p][start - s] = 1.0;
+                copy(R.data[k0 + p] + start + 1, R.data[k0 + p] + n, Vt.data[p] + start - s + 1);
+            }
+            vector<double*> C = block_rows(Q.data, s, s, n - s);
+            apply_reflectors(Vt, tau.data() + k0, C.data(), cols - s, false);
+        }
+        return Q;
+    }
+
+    /* Трёхдиагонализация симметричной A на месте: A = Q T Q^T, Q = H_0 ... H_{n-2}.
+    Используется верхний треугольник по строкам: H_i обнуляет a[i][i+2..], его
+    вектор остаётся в строке i (единица в a[i][i+1]). d - диагональ T, e[i] = T(i, i+1).
+    Блочный вариант DSYTRD из LAPACK: строки панели (NB штук) обновляются отложенно
+    через W, а остаток матрицы - одним gemm A -= V W^T + W V^T по блокам строк */
+    static void tridiagonalize(Matrix& A, vector<double>& d, vector<double>& e, vector<double>& tau){
+        const int NB = 32;
+        int n = A.rows;
+        double** a = A.data;
+        Matrix W(NB, n);
+        for (int k = 0; k < n; k += NB){
+            int nb = min(NB, n - k);
+            for (int p = 0; p < nb; ++p){
+                int i = k + p;
+                double* ai = a[i];
+                for (int q = 0; q < p; ++q){
+                    const double* vq = a[k + q];
+                    const double* wq = W.data[q];
+                    double vi = vq[i], wi = wq[i];
+                    for (int c = i; c < n; ++c){
+                        ai[c] -= vi * wq[c] + wi * vq[c];
+                    }
+                }
+                d[i] = ai[i];
+                if (i == n - 1){
+                    e[i] = 0.0;
+                    tau[i] = 0.0;
+                    break;
+                }
+                e[i] = make_reflector(ai + i + 1, n - i - 1, tau[i]);
+                ai[i + 1] = 1.0;
+
+                // w = tau (A22 v - V W^T v - W V^T v), A22 - ещё не обновлённый хвост
+                const double* v = ai;
+                double* w = W.data[p];
+                fill(w, w + n, 0.0);
+                for (int r = i + 1; r < n; ++r){
+                    const double* ar = a[r];
+                    double vr = v[r], s = ar[r] * vr;
+                    for (int c = r + 1; c < n; ++c){
+                        s += ar[c] * v[c];
+                        w[c] += ar[c] * vr;
+                    }
+                    w[r] += s;
+                }
+                for (int q = 0; q < p; ++q){
+                    const double* vq = a[k + q];
+                    const double* wq = W.data[q];
+                    double sw = 0.0, sv = 0.0;
+                    for (int c = i + 1; c < n; ++c){
+                        sw += wq[c] * v[c];
+                        sv += vq[c] * v[c];
+                    }
+                    for (int c = i + 1; c < n; ++c){
+                        w[c] -= vq[c] * sw + wq[c] * sv;
+                    }
+                }
+                double vw = 0.0;
+                for (int c = i + 1; c < n; ++c){
+                    w[c] *= tau[i];
+                    vw += w[c] * v[c];
+                }
+                double alpha = -0.5 * tau[i] * vw;
+                for (int c = i + 1; c < n; ++c){
+                    w[c] += alpha * v[c];
+                }
+            }
+
+            int k1 = k + nb, len = n - k1;
+            if (len <= 0)
+                continue;
+            Matrix L(len, 2 * nb);
+            vector<double*> R(2 * nb);
+            for (int q = 0; q < nb; ++q){
+                for (int r = 0; r < len; ++r){
+                    L.data[r][q] = -a[k + q][k1 + r];
+                    L.data[r][nb + q] = -W.data[q][k1 + r];
+                }
+            }
+            // Блоками по 64 строки, каждый - от своей диагонали вправо
+            for (int r0 = 0; r0 < len; r0 += 64){
+                int r1 = min(r0 + 64, len);
+                for (int q = 0; q < nb; ++q){
+                    R[q] = W.data[q] + k1 + r0;
+                    R[nb + q] = a[k + q] + k1 + r0;
+                }
+                vector<double*> C = block_rows(a, k1 + r0, k1 + r0, r1 - r0);
+                gemm(C.data(), L.data + r0, R.data(), r1 - r0, 2 * nb, len - r0);
+            }
+        }
+    }
+
+    /* Нижняя форма Хессенберга на месте: A = P L P^T, L(i, j) = 0 при j > i + 1.
+    H_j обнуляет a[j][j+2..], вектор остаётся в строке j. Панель из NB строк
+    обновляется отложенно: слева через Zt = T^T V^T A, справа через V и T
+    (как Y = A V T в DLAHR2 LAPACK), остальные строки - тремя gemm.
+    Возвращает поддиагональ s[j] = L(j, j+1) вместо векторов отражений */
+    static void lower_hessenberg(Matrix& A, vector<double>& s){
+        const int NB = 32;
+        int n = A.rows;
+        double** a = A.data;
+        Matrix Zt(NB, n), T(NB, NB);
+        vector<double> tau(NB), z(NB), y(NB);
+        // Элемент c вектора отражения из строки j (единица в столбце j + 1)
+        auto v = [&](int j, int c){ return c <= j ? 0.0 : c == j + 1 ? 1.0 : a[j][c]; };
+        for (int k = 0; k < n - 2; k += NB){
+            int nb = min(NB, n - 2 - k);
+            for (int p = 0; p < nb; ++p){
+                int j = k + p;
+                double* b = a[j];
+                // Слева: b -= V(j, :) Zt
+                for (int q = 0; q < p; ++q){
+                    double f = v(k + q, j);
+                    if (f == 0.0)
+                        continue;
+                    const double* zq = Zt.data[q];
+                    for (int c = 0; c < n; ++c){
+                        b[c] -= f * zq[c];
+                    }
+                }
+                // Справа: b -= (b V) T V^T
+                for (int q = 0; q < p; ++q){
+                    double sum = 0.0;
+                    for (int c = k + q + 1; c < n; ++c){
+                        sum += b[c] * v(k + q, c);
+                    }
+                    z[q] = sum;
+                }
+                for (int r = 0; r < p; ++r){
+                    double sum = 0.0;
+                    for (int q = 0; q <= r; ++q){
+                        sum += z[q] * T.data[q][r];
+                    }
+                    y[r] = sum;
+                }
+                for (int r = 0; r < p; ++r){
+                    for (int c = k + r + 1; c < n; ++c){
+                        b[c] -= y[r] * v(k + r, c);
+                    }
+                }
+                s[j] = make_reflector(b + j + 1, n - j - 1, tau[p]);
+                b[j + 1] = 1.0;
+
+                // Столбец T и строка Zt[p] = tau (v^T A - (V^T v)^T Zt) по исходным строкам
+                for (int q = 0; q < p; ++q){
+                    z[q] = dot(a[k + q] + j + 2, b + j + 2, n - j - 2) + a[k + q][j + 1];
+                }
+                for (int q = 0; q < p; ++q){
+                    double sum = 0.0;
+                    for (int r = q; r < p; ++r){
+                        sum += T.data[q][r] * z[r];
+                    }
+                    T.data[q][p] = -tau[p] * sum;
+                }
+                T.data[p][p] = tau[p];
+                double* zp = Zt.data[p];
+                fill(zp, zp + n, 0.0);
+                for (int r = j + 1; r < n; ++r){
+                    double f = b[r];
+                    const double* ar = a[r];
+                    for (int c = 0; c < n; ++c){
+                        zp[c] += f * ar[c];
+                    }
+                }
+                for (int q = 0; q < p; ++q){
+                    const double* zq = Zt.data[q];
+                    for (int c = 0; c < n; ++c){
+                        zp[c] -= z[q] * zq[c];
+                    }
+                }
+                for (int c = 0; c < n; ++c){
+                    zp[c] *= tau[p];
+                }
+            }
+
+            // Строки ниже панели: слева A -= V Zt, справа A -= (A V) T V^T
+            int k1 = k + nb, count = n - k1, len = n - k - 1;
+            Matrix L(count, nb), Vm(len, nb), Vt(nb, len), AV(count, nb, 0.0), AVT(count, nb, 0.0);
+            Matrix Tn(nb, nb, 0.0);
+            for (int q = 0; q < nb; ++q){
+                for (int r = 0; r < count; ++r){
+                    L.data[r][q] = -v(k + q, k1 + r);
+                }
+                for (int c = 0; c < len; ++c){
+                    Vt.data[q][c] = Vm.data[c][q] = v(k + q, k + 1 + c);
+                }
+                for (int r = 0; r <= q; ++r){
+                    Tn.data[r][q] = -T.data[r][q];
+                }
+            }
+            gemm(a + k1, L.data, Zt.data, count, nb, n);
+            vector<double*> C = block_rows(a, k1, k + 1, count);
+            gemm(AV.data, C.data(), Vm.data, count, len, nb);
+            gemm(AVT.data, AV.data, Tn.data, count, nb, nb);
+            gemm(C.data(), AVT.data, Vt.data, count, nb, len);
+        }
+        for (int j = max(n - 2, 0); j < n - 1; ++j){
+            s[j] = a[j][j + 1];
+        }
+    }
+
+    /* Бидиагонализация A (m x n, m >= n) на месте: A = Q B P^T, B - верхняя
+    двухдиагональная (d - диагональ, e[j] = B(j, j+1)). Левое отражение j хранится
+    в столбце j (единица на диагонали), правое - в строке j (единица в a[j][j+1]).
+    Блочный вариант DGEBRD/DLABRD из LAPACK: панель из NB столбцов и строк
+    накапливает X и Y, остаток обновляется одним gemm A -= V Y^T + X U */
+    static void bidiagonalize(Matrix& A, vector<double>& d, vector<double>& e,
+                              vector<double>& tauq, vector<double>& taup){
+        const int NB = 32;
+        int m = A.rows, n = A.cols;
+        double** a = A.data;
+        Matrix Xt(NB, m), Yt(NB, n);
+        vector<double> u(m), z(NB), z2(NB);
+        for (int k = 0; k < n; k += NB){
+            int nb = min(NB, n - k);
+            for (int p = 0; p < nb; ++p){
+                int j = k + p;
+                // Столбец j: A(j:m, j) -= A(j:m, k:j) Y(j, k:j)^T + X(j:m, k:j) A(k:j, j)
+                for (int r = j; r < m; ++r){
+                    double sum = 0.0;
+                    for (int q = 0; q < p; ++q){
+                        sum += a[r][k + q] * Yt.data[q][j] + Xt.data[q][r] * a[k + q][j];
+                    }
+                    u[r] = a[r][j] - sum;
+                }
+                d[j] = make_reflector(u.data() + j, m - j, tauq[j]);
+                u[j] = 1.0;
+                for (int r = j; r < m; ++r){
+                    a[r][j] = u[r];
+                }
+                if (j == n - 1){
+                    e[j] = 0.0;
+                    taup[j] = 0.0;
+                    break;
+                }
+
+                // Y(j+1:n, j) = tauq (A^T u - Y (A(j:m, k:j)^T u) - A(k:j, :)^T (X^T u))
+                double* y = Yt.data[p];
+                fill(y, y + n, 0.0);
+                for (int r = j; r < m; ++r){
+                    double f = u[r];
+                    const double* ar = a[r];
+                    for (int c = j + 1; c < n; ++c){
+                        y[c] += f * ar[c];
+                    }
+                }
+                for (int q = 0; q < p; ++q){
+                    double s1 = 0.0, s2 = 0.0;
+                    for (int r = j; r < m; ++r){
+                        s1 += a[r][k + q] * u[r];
+                        s2 += Xt.data[q][r] * u[r];
+                    }
+                    z[q] = s1;
+                    z2[q] = s2;
+                }
+                for (int q = 0; q < p; ++q){
+                    const double* yq = Yt.data[q];
+                    const double* aq = a[k + q];
+                    for (int c = j + 1; c < n; ++c){
+                        y[c] -= yq[c] * z[q] + aq[c] * z2[q];
+                    }
+                }
+                for (int c = j + 1; c < n; ++c){
+                    y[c] *= tauq[j];
+                }
+
+                // Строка j: A(j, j+1:n) -= Y(:, k:j+1) A(j, k:j+1)^T + A(k:j, :)^T X(j, k:j)^T
+                double* aj = a[j];
+                for (int q = 0; q <= p; ++q){
+                    double f = aj[k + q];
+                    const double* yq = Yt.data[q];
+                    for (int c = j + 1; c < n; ++c){
+                        aj[c] -= f * yq[c];
+                    }
+                }
+                for (int q = 0; q < p; ++q){
+                    double f = Xt.data[q][j];
+                    const double* aq = a[k + q];
+                    for (int c = j + 1; c < n; ++c){
+                        aj[c] -= f * aq[c];
+                    }
+                }
+                e[j] = make_reflector(aj + j + 1, n - j - 1, taup[j]);
+                aj[j + 1] = 1.0;
+
+                // X(j+1:m, j) = taup (A v - A(:, k:j+1) (Y^T v) - X (A(k:j, :) v))
+                int len = n - j - 1;
+                const double* vr = aj + j + 1;
+                for (int q = 0; q <= p; ++q){
+                    z[q] = dot(Yt.data[q] + j + 1, vr, len);
+                }
+                for (int q = 0; q < p; ++q){
+                    z2[q] = dot(a[k + q] + j + 1, vr, len);
+                }
+                double* x = Xt.data[p];
+                fill(x, x + m, 0.0);
+                for (int r = j + 1; r < m; ++r){
+                    const double* ar = a[r];
+                    double sum = dot(ar + j + 1, vr, len);
+                    for (int q = 0; q <= p; ++q){
+                        sum -= ar[k + q] * z[q];
+                    }
+                    for (int q = 0; q < p; ++q){
+                        sum -= Xt.data[q][r] * z2[q];
+                    }
+                    x[r] = sum * taup[j];
+                }
+            }
+
+            int k1 = k + nb;
+            if (k1 >= n)
+                continue;
+            int count = m - k1, len = n - k1;
+            Matrix L(count, 2 * nb);
+            vector<double*> R(2 * nb);
+            for (int q = 0; q < nb; ++q){
+                for (int r = 0; r < count; ++r){
+                    L.data[r][q] = -a[k1 + r][k + q];
+                    L.data[r][nb + q] = -Xt.data[q][k1 + r];
+                }
+                R[q] = Yt.data[q] + k1;
+                R[nb + q] = a[k + q] + k1;
+            }
+            vector<double*> C = block_rows(a, k1, k1, count);
+            gemm(C.data(), L.data, R.data(), count, 2 * nb, len);
+        }
+    }
+
+public:
+    int rows;
+    int cols;
+    Matrix() : rows(0), cols(0) {}
+
+    // Конструктор Matrix(n, m) - создает матрицу размера n x m
+    Matrix(int n, int m) : rows(n), cols(m){
+        data = new double* [rows];
+        for (int i = 0; i < rows; i++){
+            data[i] = new double[cols];
+        }
+        storage = new Storage(data, rows);
+    }
+
+    // Конструктор Matrix(const Matrix&) - copy, за O(1): буфер общий до первой записи
+    Matrix(const Matrix& other) : storage(other.storage), data(other.data), rows(other.rows), cols(other.cols){
+        if (storage)
+            storage->refs.fetch_add(1, memory_order_relaxed);
+    }
+
+    // Конструктор Matrix(Matrix&&) - move
+    Matrix(Matrix&& other) noexcept : storage(other.storage), data(other.data), rows(other.rows), cols(other.cols){
+        other.storage = nullptr;
+        other.data = nullptr;
+        other.rows = 0;
+        other.cols = 0;
+    }
+
+    // Присваивание (копированием или перемещением - по аргументу)
+    Matrix& operator=(Matrix other) noexcept{
+        swap_buffers(other);
+        return *this;
+    }
+
+    ~Matrix(){
+        release();
+    }
+
+    /* Конструктор Matrix(n, m, val) - создает матрицу 
+    размера n x m, заполненную числом val */
+    Matrix(int n, int m, double val) : rows(n), cols(m){
+        data = new double* [rows];
+        for (int i = 0; i < rows; i++){
+            data[i] = new double[cols];
+            for (int j = 0; j < cols; j++){
+                data[i][j] = val;
+            }
+        }
+        storage = new Storage(data, rows);
+    }
+
+    /* Конструктор вида (См. std::initializer_list):
+    Matrix m {
+    { 1, 2, 3 },
+    { 4, 5, 6 },
+    { 7, 8, 9 }
+    }; */
+    Matrix(initializer_list<initializer_list<double>> list){
+        rows = list.size();
+        cols = 0;
+        for (auto& x : list)
+            if (x.size() > cols)
+                cols = x.size();
+        data = new double* [rows];
+        auto it = list.begin();
+        for (int i = 0; i < rows; i++, it++){
+            data[i] = new double[cols];
+            copy(it->begin(), it->end(), data[i]);
+        }
+        storage = new Storage(data, rows);
+    }
+
+    // Статические методы:
+
+    // Identity(n, m) - возвращает матрицу с единицами по диагонали
+    static Matrix Identity(int n, int m){
+        Matrix identity(n, m, 0.0);
+        for (int i = 0; i < min(n, m); ++i){
+            identity.data[i][i] = 1.0;
+        }
+        return identity;
+    }
+
+    // Diagonal(values) - возвращает квадратную матрицу с values на диагонали
+    static Matrix Diagonal(const vector<double>& values){
+        int n = values.size();
+        Matrix diagonal(n, n, 0.0);
+        for (int i = 0; i < n; ++i){
+            diagonal.data[i][i] = values[i];
+        }
+        return diagonal;
+    }
+
+    /* Numa(n, m, val, placement, node) - матрица n x m, заполненная val, у которой
+    каждая строка выделяется и впервые записывается потоком, закреплённым
+    за нужным узлом NUMA (Linux размещает страницу на узле, где её тронули первой).
+    node используется только для NumaPlacement::Single и должен быть
+    в [0, NumaTopology::get().nodes()), иначе out_of_range */
+    static Matrix Numa(int n, int m, double val = 0.0, NumaPlacement placement = NumaPlacement::Partitioned, int node = 0){
+        const NumaTopology& topology = NumaTopology::get();
+        if (placement == NumaPlacement::Single && (node < 0 || node >= topology.nodes())){
+            throw out_of_range("Matrix::Numa: node " + to_string(node) + " is out of range for "
+                               + to_string(topology.nodes()) + " NUMA nodes");
+        }
+        Matrix result = unallocated(n, m);
+        double** rows_data = result.data;
+        auto touch = [=](int i){
+            rows_data[i] = new double[m];
+            fill(rows_data[i], rows_data[i] + m, val);
+        };
+        if (placement == NumaPlacement::Partitioned){
+            topology.parallel_rows(n, [&](int, int begin, int end){
+                for (int i = begin; i < end; ++i){
+                    touch(i);
+                }
+            });
+        }
+        else if (placement == NumaPlacement::Interleaved){
+            int nodes = topology.nodes();
+            topology.run([&](int k, int index, int count, int){
+                for (int i = k + nodes * index; i < n; i += nodes * count){
+                    touch(i);
+                }
+            });
+        }
+        else{
+            topology.run([&](int, int index, int count, int){
+                for (int i = index; i < n; i += count){
+                    touch(i);
+                }
+            }, node);
+        }
+        return result;
+    }
+
+    /* Умножение закреплёнными потоками: каждый считает свои строки результата
+    (те же куски, что у NumaPlacement::Partitioned) и сам их выделяет */
+    Matrix numa_multiply(const Matrix& other) const{
+        if (!MatrixCheck::inner("numa_multiply", cols, other.rows)){
+            return *this;
+        }
+        Matrix result = unallocated(rows, other.cols);
+        int k = cols, m = other.cols;
+        NumaTopology::get().parallel_rows(rows, [&](int, int begin, int end){
+            for (int i = begin; i < end; ++i){
+                result.data[i] = new double[m];
+                fill(result.data[i], result.data[i] + m, 0.0);
+            }
+            gemm(result.data + begin, data + begin, other.data, end - begin, k, m);
+        });
+        return result;
+    }
+
+    // Транспонирование закреплёнными потоками, блоками 64 x 64
+    Matrix numa_transpose() const{
+        const int BS = 64;
+        Matrix result = unallocated(cols, rows);
+        NumaTopology::get().parallel_rows(cols, [&](int, int begin, int end){
+            for (int j = begin; j < end; ++j){
+                result.data[j] = new double[rows];
+            }
+            for (int ii = 0; ii < rows; ii += BS){
+                int ie = min(ii + BS, rows);
+                for (int j = begin; j < end; ++j){
+                    double* t = result.data[j];
+                    for (int i = ii; i < ie; ++i){
+                        t[i] = data[i][j];
+                    }
+                }
+            }
+        });
+        return result;
+    }
+
+    /* Сумма элементов закреплёнными потоками. node >= 0 - читают только потоки
+    этого узла (для замера пропускной способности узла) */
+    double numa_sum(int node = -1) const{
+        const NumaTopology& topology = NumaTopology::get();
+        if (node >= topology.nodes()){
+            throw out_of_range("Matrix::numa_sum: node " + to_string(node) + " is out of range for "
+                               + to_string(topology.nodes()) + " NUMA nodes");
+        }
+        vector<double> partial(topology.workers(), 0.0);
+        auto add_rows = [&](int worker, int begin, int end){
+            double total = 0.0;
+            for (int i = begin; i < end; ++i){
+                const double* row = data[i];
+                for (int j = 0; j < cols; ++j){
+                    total += row[j];
+                }
+            }
+            partial[worker] = total;
+        };
+        if (node < 0){
+            int total = topology.workers();
+            topology.run([&](int, int, int, int worker){
+                add_rows(worker, int(long(rows) * worker / total), int(long(rows) * (worker + 1) / total));
+            });
+        }
+        else{
+            topology.run([&](int, int index, int count, int worker){
+                add_rows(worker, int(long(rows) * index / count), int(long(rows) * (index + 1) / count));
+            }, node);
+        }
+        double total = 0.0;
+        for (double p : partial){
+            total += p;
+        }
+        return total;
+    }
+
+    // Zero(n, m) - возвращает матрицу, заполненную нулями
+    static Matrix Zero(int n, int m){
+        return Matrix(n, m, 0.0);
+    }
+
+    /* Random(n, m) - возвращает матрицу, заполненную случайными числами 
+    (см. std::uniform_real_distribution для генерации случайных чисел 
+    с плавающей запятой) */
+    static Matrix Random(int n, int m){
+        Matrix randomMatrix(n, m);
+        random_device rd;
+        mt19937 generator(rd());
+        uniform_real_distribution<double> distribution(0.0, 1.0);
+        for (int i = 0; i < n; ++i){
+            for (int j = 0; j < m; ++j){
+                randomMatrix.data[i][j] = distribution(generator);
+            }
+        }
+        return randomMatrix;
+    }
+
+    /* FromString(str) - парсит строку и возвращает матрицу. 
+    Формат как в питончике: [[1, 2, 3], [4, 5, 6], [7, 8, 9]] */
+    static Matrix FromString(const string& str){
+        Matrix matrix;
+        stringstream ss(str);
+        string token;
+
+        matrix.rows = 0;
+        while (getline(ss, token, '[')){
+            if (token.empty()) continue;
+            double** tmp_matrix = matrix.data;
+            matrix.data = new double* [matrix.rows + 1]();
+            for (int i = 0; i < matrix.rows; ++i){
+                matrix.data[i] = tmp_matrix[i];
+            }
+            delete[] tmp_matrix;
+            stringstream row_ss(token);
+            matrix.cols = 0;
+            while (getline(row_ss, token, ',')){
+                try{
+                    double val = stod(token);
+                    double* tmp_row = matrix.data[matrix.rows];
+                    matrix.data[matrix.rows] = new double[matrix.cols + 1];
+                    for (int i = 0; i < matrix.cols; ++i){
+                        matrix.data[matrix.rows][i] = tmp_row[i];
+                    }
+                    matrix.data[matrix.rows][matrix.cols] = val;
+                    matrix.cols++;
+                    delete[] tmp_row;
+                }
+                catch (invalid_argument& e){}
+            }
+            matrix.rows++;
+        }
+        matrix.storage = new Storage(matrix.data, matrix.rows);
+        return matrix;
+    }
+
+    // Методы:
+
+    // Элемент с проверкой по выбранной политике (at<CheckedPolicy> проверяет всегда)
+    template<class Check = MatrixCheck>
+    double at(int i, int j) const{
+        Check::index(i, j, rows, cols);
+        return data[i - 1][j - 1];
+    }
+
+    double operator()(int i, int j) const{
+        return at<MatrixCheck>(i, j);
+    }
+
+    bool operator==(const Matrix& other) const{
+        if (rows != other.rows || cols != other.cols){
+            return false;
+        }
+        for (int i = 0; i < rows; ++i){
+            for (int j = 0; j < cols; ++j){
+                if (data[i][j] != other.data[i][j]){
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool operator!=(const Matrix& other) const{
+        return !(*this == other);
+    }
+
+
+    Matrix operator-() const{
+        Matrix result(rows, cols);
+        for (int i = 0; i < rows; ++i){
+            for (int j = 0; j < cols; ++j){
+                result.data[i][j] = -data[i][j];
+            }
+        }
+        return result;
+    }
+
+    Matrix transpose() const{
+        Matrix transposed(cols, rows);
+        for (int i = 0; i < rows; ++i){
+            for (int j = 0; j < cols; ++j){
+                transposed.data[j][i] = data[i][j];
+            }
+        }
+        return transposed;
+    }
+
+    double sum() const{
+        double total = 0.0;
+        for (int i = 0; i < rows; ++i){
+            for (int j = 0; j < cols; ++j){
+                total += data[i][j];
+            }
+        }
+        return total;
+    }
+
+    Matrix operator+(const Matrix& other) const{
+        if (!MatrixCheck::same_shape("operator+", rows, cols, other.rows, other.cols)){
+            return *this;
+        }
+        Matrix result(rows, cols);
+        for (int i = 0; i < rows; ++i){
+            for (int j = 0; j < cols; ++j){
+                result.data[i][j] = data[i][j] + other.data[i][j];
+            }
+        }
+        return result;
+    }
+
+    Matrix operator-(const Matrix& other) const{
+        if (!MatrixCheck::same_shape("operator-", rows, cols, other.rows, other.cols)){
+            return *this;
+        }
+        Matrix result(rows, cols);
+        for (int i = 0; i < rows; ++i){
+            for (int j = 0; j < cols; ++j){
+                result.data[i][j] = data[i][j] - other.data[i][j];
+            }
+        }
+        return result;
+    }
+
+    Matrix operator*(const Matrix& other) const{
+        if (!MatrixCheck::inner("operator*", cols, other.rows)){
+            return *this;
+        }
+        Matrix result(rows, other.cols, 0.0);
+        gemm(result.data, data, other.data, rows, cols, other.cols);
+        return result;
+    }
+
+    Matrix RemoveColRow(Matrix src, int rows, int cols, int row, int col) const{
+        int di, dj;
+        Matrix result(rows - 1, cols - 1);
+        di = 0;
+        for (int i = 0; i < rows - 1; i++){
+            if (i == row)
+                di = 1;
+            dj = 0;
+            for (int j = 0; j < cols - 1; j++){
+                if (j == col)
+                    dj = 1;
+                result.data[i][j] = src.data[i + di][j + dj];
+            }
+        }
+        return result;
+    }
+
+    double Determ(Matrix src, int m) const{
+        int k = 1;
+        double det = 0;
+        if (m < 1)
+            return 0;
+        if (m == 1){
+            det = src.data[0][0];
+            return det;
+        }
+        if (m == 2){
+            det = src.data[0][0] * src.data[1][1] - (src.data[1][0] * src.data[0][1]);
+            return det;
+        }
+        if (m > 2){
+            for (int i = 0; i < m; i++){
+                Matrix result = RemoveColRow(src, m, m, i, 0);
+                det = det + k * src.data[i][0] * Determ(result, m - 1);
+                k = -k;
+            }
+        }
+        return det;
+    }
+
+    /* Решение A X = B (A - квадратная, B - n x m) LU-разложением.
+    SolvePrecision::Mixed раскладывает A во float и уточняет ответ в double
+    до точности double; если не сошлось, автоматически решает заново в double.
+    Шаг уточнения стоит O(n^2 m), поэтому при многих правых частях (m ~ n)
+    он дороже выигрыша от float; SolvePrecision::Auto выбирает по m.
+    В refinements (если не nullptr) пишется число шагов уточнения,
+    0 для SolvePrecision::Double и -1, если пришлось откатиться на double */
+    Matrix solve(const Matrix& B, SolvePrecision precision = SolvePrecision::Auto, int* refinements = nullptr) const{
+        MatrixCheck::square("solve", rows, cols);
+        if (!MatrixCheck::inner("solve", cols, B.rows)){
+            return *this;
+        }
+        int n = rows, m = B.cols;
+        if (precision == SolvePrecision::Auto){
+            precision = 4 * m <= n ? SolvePrecision::Mixed : SolvePrecision::Double;
+        }
+        Matrix X(n, m);
+        int steps = 0;
+        if (precision == SolvePrecision::Mixed && solve_mixed(B, X, steps)){
+            if (refinements)
+                *refinements = steps;
+            return X;
+        }
+        vector<double> lu(size_t(n) * n), x(size_t(n) * m);
+        vector<int> pivot(n);
+        for (int i = 0; i < n; ++i){
+            pivot[i] = i;
+            copy(data[i], data[i] + n, lu.begin() + size_t(i) * n);
+            copy(B.data[i], B.data[i] + m, x.begin() + size_t(i) * m);
+        }
+        if (!lu_factor(lu.data(), pivot.data(), n)){
+            MatrixCheck::invertible(0.0);
+        }
+        lu_solve(lu.data(), pivot.data(), n, x.data(), m);
+        for (int i = 0; i < n; ++i){
+            copy(x.begin() + size_t(i) * m, x.begin() + size_t(i) * m + m, X.data[i]);
+        }
+        if (refinements)
+            *refinements = precision == SolvePrecision::Mixed ? -1 : 0;
+        return X;
+    }
+
+    /* Обратная матрица. До 3 x 3 - через алгебраические дополнения,
+    больше - через solve(I) в double: при n правых частях каждый шаг
+    уточнения стоит столько же, сколько само разложение, и смешанная
+    точность только замедляет */
+    Matrix reverse() const{
+        MatrixCheck::square("reverse", rows, cols);
+        int m = rows;
+        if (m > 3){
+            return solve(Identity(m, m), SolvePrecision::Double);
+        }
+        Matrix result(m, m);
+        double det = Determ(*this, m);
+        MatrixCheck::invertible(det);
+        for (int i = 0; i < m; i++){
+            for (int j = 0; j < m; j++){
+                result.data[i][j] = Determ(RemoveColRow(*this, m, m, i, j), m - 1);
+                if ((i + j) % 2 == 1)
+                    result.data[i][j] = -result.data[i][j];
+                result.data[i][j] = result.data[i][j] / det;
+            }
+        }
+        return result.transpose();
+    }
+
+    /* Деление справа X / A = X A^-1 = (A^-T X^T)^T, без явного обращения.
+    Строки X становятся правыми частями, точность выбирает solve */
+    Matrix operator/(const Matrix& other) const{
+        if (other.rows <= 3){
+            return *this * other.reverse();
+        }
+        if (!MatrixCheck::inner("operator/", cols, other.rows)){
+            return *this;
+        }
+        return other.transpose().solve(transpose()).transpose();
+    }
+
+    Matrix operator+(double scalar) const{
+        Matrix result(rows, cols);
+        for (int i = 0; i < rows; ++i){
+            for (int j = 0; j < cols; ++j){
+                result.data[i][j] = data[i][j] + scalar;
+            }
+        }
+        return result;
+    }
+
+
+    Matrix operator-(double scalar) const{
+        Matrix result(rows, cols);
+        for (int i = 0; i < rows; ++i){
+            for (int j = 0; j < cols; ++j){
+                result.data[i][j] = data[i][j] - scalar;
+            }
+        }
+        return result;
+    }
+
+    Matrix operator*(double scalar) const{
+        Matrix result(rows, cols);
+        for (int i = 0; i < rows; ++i){
+            for (int j = 0; j < cols; ++j){
+                result.data[i][j] = data[i][j] * scalar;
+            }
+        }
+        return result;
+    }
+
+    Matrix operator/(double scalar) const{
+        Matrix result(rows, cols);
+        MatrixCheck::divisor(scalar);
+        for (int i = 0; i < rows; ++i){
+            for (int j = 0; j < cols; ++j){
+                result.data[i][j] = data[i][j] / scalar;
+            }
+        }
+        return result;
+    }
+
+    /* Степень A^n возведением в квадрат: около 2 log2(n) умножений вместо n - 1.
+    Все произведения пишутся в три заранее выделенных буфера, которые
+    меняются ролями обменом указателей. Если multiplies != nullptr,
+    туда записывается число умножений матриц */
+    Matrix pow(int n, int* multiplies = nullptr) const{
+        MatrixCheck::square("pow", rows, cols);
+        if (n < 0){
+            throw invalid_argument("pow: negative exponent");
+        }
+        int count = 0;
+        Matrix result = n == 0 ? Identity(rows, cols) : Matrix(rows, cols);
+        if (n > 0){
+            Matrix base = clone(), tmp(rows, cols);
+            bool started = false;
+            while (true){
+                if (n & 1){
+                    if (started){
+                        multiply_into(tmp, result, base);
+                        tmp.swap_buffers(result);
+                        ++count;
+                    }
+                    else{
+                        result.assign_from(base);
+                        started = true;
+                    }
+                }
+                n >>= 1;
+                if (n == 0)
+                    break;
+                multiply_into(tmp, base, base);
+                tmp.swap_buffers(base);
+                ++count;
+            }
+        }
+        if (multiplies)
+            *multiplies = count;
+        return result;
+    }
+
+    /* Многочлен coeffs[0] I + coeffs[1] A + ... + coeffs[d] A^d по схеме
+    Паттерсона-Стокмейера: степени A^2..A^s (s ~ sqrt(d)) считаются один раз,
+    затем схема Горнера по A^s. Итого около 2 sqrt(d) умножений вместо d */
+    Matrix polynomial(const vector<double>& coeffs, int* multiplies = nullptr) const{
+        MatrixCheck::square("polynomial", rows, cols);
+        int n = rows, d = int(coeffs.size()) - 1, count = 0;
+        Matrix result(n, n, 0.0);
+        if (d < 0){
+            if (multiplies)
+                *multiplies = 0;
+            return result;
+        }
+        int s = max(1, int(ceil(sqrt(double(d + 1)))));
+        // powers[i] = A^i, i = 1..s
+        vector<Matrix> powers;
+        powers.push_back(Matrix());
+        powers.push_back(clone());
+        for (int i = 2; i <= s && i <= d; ++i){
+            powers.push_back(Matrix(n, n));
+            multiply_into(powers[i], powers[i - 1], powers[1]);
+            ++count;
+        }
+        // Блок j: сумма coeffs[j s + i] A^i по i < s (для последнего блока - до d)
+        Matrix tmp(n, n);
+        int blocks = d / s + 1;
+        for (int j = blocks - 1; j >= 0; --j){
+            if (j < blocks - 1){
+                multiply_into(tmp, result, powers[s]);
+                tmp.swap_buffers(result);
+                ++count;
+            }
+            for (int i = 0; i < s && j * s + i <= d; ++i){
+                double c = coeffs[j * s + i];
+                if (c == 0.0)
+                    continue;
+                if (i == 0){
+                    for (int k = 0; k < n; ++k){
+                        result.data[k][k] += c;
+                    }
+                }
+                else{
+                    add_scaled(result, c, powers[i]);
+                }
+            }
+            // Старший блок может доходить ровно до A^s
+            if (j == blocks - 1 && (j + 1) * s <= d){
+                add_scaled(result, coeffs[(j + 1) * s], powers[s]);
+            }
+        }
+        if (multiplies)
+            *multiplies = count;
+        return result;
+    }
+
+    /* Матричная экспонента: масштабирование и возведение в квадрат
+    с аппроксимацией Паде степени 3, 5, 7, 9 или 13 (Higham, 2005).
+    Степень выбирается по 1-норме; для степени 13 матрица делится на 2^k,
+    а результат k раз возводится в квадрат */
+    Matrix expm(int* multiplies = nullptr) const{
+        MatrixCheck::square("expm", rows, cols);
+        static const double theta[] = {1.495585217958292e-2, 2.539398330063230e-1,
+                                       9.504178996162932e-1, 2.097847961257068, 5.371920351148152};
+        static const int degrees[] = {3, 5, 7, 9, 13};
+        static const double b3[] = {120, 60, 12, 1};
+        static const double b5[] = {30240, 15120, 3360, 420, 30, 1};
+        static const double b7[] = {17297280, 8648640, 1995840, 277200, 25200, 1512, 56, 1};
+        static const double b9[] = {17643225600., 8821612800., 2075673600., 302702400., 30270240.,
+                                    2162160., 110880., 3960., 90., 1.};
+        static const double b13[] = {64764752532480000., 32382376266240000., 7771770303897600.,
+                                     1187353796428800., 129060195264000., 10559470521600.,
+                                     670442572800., 33522128640., 1323241920., 40840800.,
+                                     960960., 16380., 182., 1.};
+        static const double* coefficients[] = {b3, b5, b7, b9, b13};
+
+        int n = rows, count = 0;
+        double norm = 0.0;
+        for (int j = 0; j < n; ++j){
+            double s = 0.0;
+            for (int i = 0; i < n; ++i){
+                s += fabs(data[i][j]);
+            }
+            norm = max(norm, s);
+        }
+        int choice = 0;
+        while (choice < 4 && norm > theta[choice]){
+            ++choice;
+        }
+        int squarings = 0;
+        if (choice == 4 && norm > theta[4]){
+            squarings = int(ceil(log2(norm / theta[4])));
+        }
+        int m = degrees[choice];
+        const double* b = coefficients[choice];
+
+        Matrix A = clone();
+        if (squarings > 0){
+            double scale = ldexp(1.0, -squarings);
+            for (int i = 0; i < n; ++i){
+                for (int j = 0; j < n; ++j){
+                    A.data[i][j] *= scale;
+                }
+            }
+        }
+        // Чётные степени A^2, A^4, A^6 (и A^8 для степени 9)
+        vector<Matrix> even;
+        even.push_back(Matrix(n, n));
+        multiply_into(even[0], A, A);
+        ++count;
+        int needed = m == 13 ? 3 : (m - 1) / 2;
+        for (int k = 1; k < needed; ++k){
+            even.push_back(Matrix(n, n));
+            multiply_into(even[k], even[k - 1], even[0]);
+            ++count;
+        }
+
+        // U = A * (нечётная часть), V = чётная часть
+        Matrix U(n, n), V(n, n, 0.0), odd(n, n, 0.0);
+        if (m == 13){
+            const Matrix &A2 = even[0], &A4 = even[1], &A6 = even[2];
+            Matrix inner(n, n, 0.0);
+            add_scaled(inner, b[13], A6);
+            add_scaled(inner, b[11], A4);
+            add_scaled(inner, b[9], A2);
+            multiply_into(odd, A6, inner);
+            add_scaled(odd, b[7], A6);
+            add_scaled(odd, b[5], A4);
+            add_scaled(odd, b[3], A2);
+            for (int i = 0; i < n; ++i){
+                fill(inner.data[i], inner.data[i] + n, 0.0);
+            }
+            add_scaled(inner, b[12], A6);
+            add_scaled(inner, b[10], A4);
+            add_scaled(inner, b[8], A2);
+            multiply_into(V, A6, inner);
+            add_scaled(V, b[6], A6);
+            add_scaled(V, b[4], A4);
+            add_scaled(V, b[2], A2);
+            count += 2;
+        }
+        else{
+            for (int j = 1; j <= needed; ++j){
+                add_scaled(odd, b[2 * j + 1], even[j - 1]);
+                add_scaled(V, b[2 * j], even[j - 1]);
+            }
+        }
+        for (int i = 0; i < n; ++i){
+            odd.data[i][i] += b[1];
+            V.data[i][i] += b[0];
+        }
+        multiply_into(U, A, odd);
+        ++count;
+
+        // (V - U) R = V + U
+        Matrix P = V.clone(), Q = V.clone();
+        add_scaled(P, 1.0, U);
+        add_scaled(Q, -1.0, U);
+        solve_in_place(Q, P);
+
+        // R = R^(2^k), буферы те же
+        for (int k = 0; k < squarings; ++k){
+            multiply_into(U, P, P);
+            U.swap_buffers(P);
+            ++count;
+        }
+        if (multiplies)
+            *multiplies = count;
+        return P;
+    }
+
+    /* Собственные значения симметричной матрицы (по возрастанию).
+    Сначала блочной трёхдиагонализацией (tridiagonalize) приводим к виду
+    A = Q T Q^T, затем неявный QL-алгоритм со сдвигами. Если vectors != nullptr,
+    туда записываются собственные векторы (по столбцам): Q собирается блоками
+    отражений через gemm, а вращения QL применяются к строкам Q^T */
+    vector<double> eigen_symmetric(Matrix* vectors = nullptr) const{
+        int n = rows;
+        if (rows != cols || n == 0){
+            return vector<double>();
+        }
+        Matrix A = clone();
+        vector<double> d(n), e(n), tau(n);
+        tridiagonalize(A, d, e, tau);
+        Matrix Z;
+        if (vectors){
+            Z = reflectors_product(A, tau, n - 1, 1, n).transpose();
+        }
+
+        /* QL со сдвигами. Векторы храним транспонированными (Z = V^T),
+        тогда каждое вращение меняет две соседние строки подряд в памяти */
+        double f = 0.0, tst1 = 0.0;
+        const double eps = numeric_limits<double>::epsilon();
+        for (int l = 0; l < n; ++l){
+            tst1 = max(tst1, fabs(d[l]) + fabs(e[l]));
+            int m = l;
+            while (m < n - 1 && fabs(e[m]) > eps * tst1){
+                m++;
+            }
+            if (m > l){
+                int iter = 0;
+                do{
+                    if (++iter > 60){
+                        throw runtime_error("eigen_symmetric: QL did not converge");
+                    }
+                    double g = d[l];
+                    double p = (d[l + 1] - g) / (2.0 * e[l]);
+                    double r = hypot(p, 1.0);
+                    if (p < 0)
+                        r = -r;
+                    d[l] = e[l] / (p + r);
+                    d[l + 1] = e[l] * (p + r);
+                    double dl1 = d[l + 1];
+                    double h = g - d[l];
+                    for (int i = l + 2; i < n; ++i){
+                        d[i] -= h;
+                    }
+                    f += h;
+                    p = d[m];
+                    double c = 1.0, c2 = c, c3 = c;
+                    double el1 = e[l + 1];
+                    double s = 0.0, s2 = 0.0;
+                    for (int i = m - 1; i >= l; --i){
+                        c3 = c2;
+                        c2 = c;
+                        s2 = s;
+                        g = c * e[i];
+                        h = c * p;
+                        r = hypot(p, e[i]);
+                        e[i + 1] = s * r;
+                        s = e[i] / r;
+                        c = p / r;
+                        p = c * d[i] - s * g;
+                        d[i + 1] = h + s * (c * g + s * d[i]);
+                        if (vectors){
+                            double* zi = Z.data[i];
+                            double* zi1 = Z.data[i + 1];
+                            for (int k = 0; k < n; ++k){
+                                h = zi1[k];
+                                zi1[k] = s * zi[k] + c * h;
+                                zi[k] = c * zi[k] - s * h;
+                            }
+                        }
+                    }
+                    p = -s * s2 * c3 * el1 * e[l] / dl1;
+                    e[l] = s * p;
+                    d[l] = c * p;
+                } while (fabs(e[l]) > eps * tst1);
+            }
+            d[l] = d[l] + f;
+            e[l] = 0.0;
+        }
+
+        // Сортировка по возрастанию вместе с векторами
+        vector<int> order(n);
+        for (int i = 0; i < n; ++i){
+            order[i] = i;
+        }
+        sort(order.begin(), order.end(), [&](int a, int b){ return d[a] < d[b]; });
+        vector<double> values(n);
+        for (int i = 0; i < n; ++i){
+            values[i] = d[order[i]];
+        }
+        if (vectors){
+            Matrix result(n, n);
+            for (int j = 0; j < n; ++j){
+                const double* z = Z.data[order[j]];
+                for (int k = 0; k < n; ++k){
+                    result.data[k][j] = z[k];
+                }
+            }
+            *vectors = move(result);
+        }
+        return values;
+    }
+
+    /* Собственные значения произвольной квадратной матрицы.
+    Блочно приводим к нижней форме Хессенберга L (lower_hessenberg), у L^T -
+    верхней формы Хессенберга - те же собственные значения; затем QR-алгоритм
+    Фрэнсиса с двойным сдвигом. Значения могут быть комплексными */
+    vector<complex<double>> eigenvalues() const{
+        int n = rows;
+        if (rows != cols || n == 0){
+            return vector<complex<double>>();
+        }
+        Matrix L = clone();
+        vector<double> sub(n);
+        lower_hessenberg(L, sub);
+        Matrix H(n, n, 0.0);
+        double** a = H.data;
+        for (int i = 0; i < n; ++i){
+            for (int j = max(i - 1, 0); j < n; ++j){
+                a[i][j] = j == i - 1 ? sub[j] : L.data[j][i];
+            }
+        }
+
+        // QR с двойным сдвигом
+        vector<complex<double>> w(n);
+        const double eps = numeric_limits<double>::epsilon();
+        double anorm = 0.0;
+        for (int i = 0; i < n; ++i){
+            for (int j = max(i - 1, 0); j < n; ++j){
+                anorm += fabs(a[i][j]);
+            }
+        }
+        int nn = n - 1, l = 0;
+        double t = 0.0;
+        while (nn >= 0){
+            int its = 0;
+            do{
+                for (l = nn; l > 0; --l){
+                    double s = fabs(a[l - 1][l - 1]) + fabs(a[l][l]);
+                    if (s == 0.0)
+                        s = anorm;
+                    if (fabs(a[l][l - 1]) <= eps * s){
+                        a[l][l - 1] = 0.0;
+                        break;
+                    }
+                }
+                double x = a[nn][nn];
+                if (l == nn){
+                    w[nn--] = x + t;
+                }
+                else{
+                    double y = a[nn - 1][nn - 1];
+                    double ww = a[nn][nn - 1] * a[nn - 1][nn];
+                    if (l == nn - 1){
+                        double p = 0.5 * (y - x);
+                        double q = p * p + ww;
+                        double z = sqrt(fabs(q));
+                        x += t;
+                        if (q >= 0.0){
+                            z = p + copysign(z, p);
+                            w[nn - 1] = w[nn] = x + z;
+                            if (z != 0.0)
+                                w[nn] = x - ww / z;
+                        }
+                        else{
+                            w[nn] = complex<double>(x + p, -z);
+                            w[nn - 1] = conj(w[nn]);
+                        }
+                        nn -= 2;
+                    }
+                    else{
+                        if (its == 60){
+                            throw runtime_error("eigenvalues: QR did not converge");
+                        }
+                        if (its % 10 == 0 && its > 0){
+                            // Исключительный сдвиг
+                            t += x;
+                            for (int i = 0; i <= nn; ++i){
+                                a[i][i] -= x;
+                            }
+                            double s = fabs(a[nn][nn - 1]) + fabs(a[nn - 1][nn - 2]);
+                            y = x = 0.75 * s;
+                            ww = -0.4375 * s * s;
+                        }
+                        ++its;
+                        int m;
+                        double p = 0, q = 0, r = 0, z;
+                        for (m = nn - 2; m >= l; --m){
+                            z = a[m][m];
+                            r = x - z;
+                            double s = y - z;
+                            p = (r * s - ww) / a[m + 1][m] + a[m][m + 1];
+                            q = a[m + 1][m + 1] - z - r - s;
+                            r = a[m + 2][m + 1];
+                            s = fabs(p) + fabs(q) + fabs(r);
+                            p /= s;
+                            q /= s;
+                            r /= s;
+                            if (m == l)
+                                break;
+                            double u = fabs(a[m][m - 1]) * (fabs(q) + fabs(r));
+                            double v = fabs(p) * (fabs(a[m - 1][m - 1]) + fabs(z) + fabs(a[m + 1][m + 1]));
+                            if (u <= eps * v)
+                                break;
+                        }
+                        for (int i = m; i < nn - 1; ++i){
+                            a[i + 2][i] = 0.0;
+                            if (i != m)
+                                a[i + 2][i - 1] = 0.0;
+                        }
+                        for (int k = m; k < nn; ++k){
+                            if (k != m){
+                                p = a[k][k - 1];
+                                q = a[k + 1][k - 1];
+                                r = 0.0;
+                                if (k + 1 != nn)
+                                    r = a[k + 2][k - 1];
+                                if ((x = fabs(p) + fabs(q) + fabs(r)) != 0.0){
+                                    p /= x;
+                                    q /= x;
+                                    r /= x;
+                                }
+                            }
+                            double s = copysign(sqrt(p * p + q * q + r * r), p);
+                            if (s != 0.0){
+                                if (k == m){
+                                    if (l != m)
+                                        a[k][k - 1] = -a[k][k - 1];
+                                }
+                                else
+                                    a[k][k - 1] = -s * x;
+                                p += s;
+                                x = p / s;
+                                y = q / s;
+                                z = r / s;
+                                q /= p;
+                                r /= p;
+                                // Ветвление вынесено из цикла, чтобы компилятор его векторизовал
+                                double* a0 = a[k];
+                                double* a1 = a[k + 1];
+                                if (k + 1 != nn){
+                                    double* a2 = a[k + 2];
+                                    for (int j = k; j <= nn; ++j){
+                                        double h = a0[j] + q * a1[j] + r * a2[j];
+                                        a2[j] -= h * z;
+                                        a1[j] -= h * y;
+                                        a0[j] -= h * x;
+                                    }
+                                }
+                                else{
+                                    for (int j = k; j <= nn; ++j){
+                                        double h = a0[j] + q * a1[j];
+                                        a1[j] -= h * y;
+                                        a0[j] -= h * x;
+                                    }
+                                }
+                                int mmin = nn < k + 3 ? nn : k + 3;
+                                for (int i = l; i <= mmin; ++i){
+                                    p = x * a[i][k] + y * a[i][k + 1];
+                                    if (k + 1 != nn){
+                                        p += z * a[i][k + 2];
+                                        a[i][k + 2] -= p * r;
+                                    }
+                                    a[i][k + 1] -= p * q;
+                                    a[i][k] -= p;
+                                }
+                            }
+                        }
+                    }
+                }
+            } while (l + 1 < nn);
+        }
+        return w;
+    }
+
+    /* Тонкое сингулярное разложение A = U * diag(s) * V^T.
+    Блочной бидиагонализацией (bidiagonalize) приводим к виду A = Q B P^T,
+    затем неявный QR со сдвигом Голуба - Кахана на двухдиагональной B.
+    U и V собираются из отражений блоками через gemm, а вращения QR
+    применяются к строкам U^T и V^T, чтобы идти по памяти подряд.
+    Сингулярные числа по убыванию; U - rows x k, V - cols x k, k = min(rows, cols) */
+    vector<double> svd(Matrix* U = nullptr, Matrix* V = nullptr) const{
+        if (rows < cols){
+            return transpose().svd(V, U);
+        }
+        int m = rows, n = cols;
+        if (n == 0){
+            return vector<double>();
+        }
+        Matrix A = clone();
+        vector<double> w(n), e(n), tauq(n), taup(n);
+        bidiagonalize(A, w, e, tauq, taup);
+        Matrix Ut, Vt;
+        if (U)
+            Ut = reflectors_product(A.transpose(), tauq, n, 0, n).transpose();
+        if (V)
+            Vt = reflectors_product(A, taup, n - 1, 1, n).transpose();
+
+        // rv1[i] = B(i-1, i)
+        vector<double> rv1(n);
+        double anorm = 0.0;
+        for (int i = 0; i < n; ++i){
+            rv1[i] = i > 0 ? e[i - 1] : 0.0;
+            anorm = max(anorm, fabs(w[i]) + fabs(rv1[i]));
+        }
+        const double tol = numeric_limits<double>::epsilon() * anorm;
+        // Вращение строк p и q: (p, q) <- (c p + s q, c q - s p)
+        auto rotate = [](Matrix& M, int p, int q, double c, double s){
+            if (M.rows == 0)
+                return;
+            double* mp = M.data[p];
+            double* mq = M.data[q];
+            for (int j = 0; j < M.cols; ++j){
+                double x = mp[j], y = mq[j];
+                mp[j] = x * c + y * s;
+                mq[j] = y * c - x * s;
+            }
+        };
+        for (int k = n - 1; k >= 0; --k){
+            for (int its = 0;; ++its){
+                // Ищем l: rv1[l] пренебрежимо мал или w[l-1] = 0
+                bool cancel = true;
+                int l;
+                for (l = k; l >= 0; --l){
+                    if (l == 0 || fabs(rv1[l]) <= tol){
+                        cancel = false;
+                        break;
+                    }
+                    if (fabs(w[l - 1]) <= tol)
+                        break;
+                }
+                if (cancel){
+                    // w[l-1] = 0: зануляем rv1[l] вращениями слева
+                    double c = 0.0, s = 1.0;
+                    for (int i = l; i <= k; ++i){
+                        double f = s * rv1[i];
+                        rv1[i] *= c;
+                        if (fabs(f) <= tol)
+                            break;
+                        double g = w[i];
+                        double h = hypot(f, g);
+                        w[i] = h;
+                        c = g / h;
+                        s = -f / h;
+                        rotate(Ut, l - 1, i, c, s);
+                    }
+                }
+                double z = w[k];
+                if (l == k){
+                    if (z < 0.0){
+                        w[k] = -z;
+                        if (V){
+                            for (int j = 0; j < n; ++j){
+                                Vt.data[k][j] = -Vt.data[k][j];
+                            }
+                        }
+                    }
+                    break;
+                }
+                if (its == 75){
+                    throw runtime_error("svd: QR did not converge");
+                }
+                // Сдвиг по нижнему блоку 2 x 2
+                double x = w[l], y = w[k - 1];
+                double g = rv1[k - 1], h = rv1[k];
+                double f = ((y - z) * (y + z) + (g - h) * (g + h)) / (2.0 * h * y);
+                g = hypot(f, 1.0);
+                f = ((x - z) * (x + z) + h * (y / (f + copysign(g, f)) - h)) / x;
+                double c = 1.0, s = 1.0;
+                for (int j = l; j < k; ++j){
+                    int i = j + 1;
+                    g = rv1[i];
+                    y = w[i];
+                    h = s * g;
+                    g = c * g;
+                    z = hypot(f, h);
+                    rv1[j] = z;
+                    c = f / z;
+                    s = h / z;
+                    f = x * c + g * s;
+                    g = g * c - x * s;
+                    h = y * s;
+                    y *= c;
+                    rotate(Vt, j, i, c, s);
+                    z = hypot(f, h);
+                    w[j] = z;
+                    if (z != 0.0){
+                        c = f / z;
+                        s = h / z;
+                    }
+                    f = c * g + s * y;
+                    x = c * y - s * g;
+                    rotate(Ut, j, i, c, s);
+                }
+                rv1[l] = 0.0;
+                rv1[k] = f;
+                w[k] = x;
+            }
+        }
+
+        vector<int> order(n);
+        for (int i = 0; i < n; ++i){
+            order[i] = i;
+        }
+        sort(order.begin(), order.end(), [&](int a, int b){ return w[a] > w[b]; });
+        vector<double> values(n);
+        for (int j = 0; j < n; ++j){
+            values[j] = w[order[j]];
+        }
+        if (U){
+            Matrix result(m, n);
+            for (int j = 0; j < n; ++j){
+                const double* u = Ut.data[order[j]];
+                for (int k = 0; k < m; ++k){
+                    result.data[k][j] = u[k];
+                }
+            }
+            *U = move(result);
+        }
+        if (V){
+            Matrix result(n, n);
+            for (int j = 0; j < n; ++j){
+                const double* v = Vt.data[order[j]];
+                for (int k = 0; k < n; ++k){
+                    result.data[k][j] = v[k];
+                }
+            }
+            *V = move(result);
+        }
+        return values;
+    }
+
+    friend ostream& operator<<(ostream& os, const Matrix& matrix){
+        os << "[";
+        for (int i = 0; i < matrix.rows; ++i){
+            os << "[";
+            for (int j = 0; j < matrix.cols; ++j){
+                os << matrix.data[i][j];
+                if (j < matrix.cols - 1){
+                    os << ", ";
+                }
+            }
+            os << "]";
+            if (i < matrix.rows - 1){
+                os << ", ";
+            }
+        }
+        os << "]";
+        return os;
+    }
+};
+
+
+/* QR-разложение A = Q * R отражениями Хаусхолдера (A - m x n, m >= n).
+Столбцы обрабатываются панелями по NB штук: внутри панели обычные отражения,
+а к остальной части матрицы панель применяется сразу целиком в компактной
+WY-форме I - V T V^T, то есть через умножения матриц, а не n отдельных проходов.
+R хранится в верхнем треугольнике, векторы Хаусхолдера - под диагональю */
+class QR{
+private:
+    static const int NB = 32;
+    Matrix qr;
+    Matrix q;              // явная тонкая Q, появляется после add_row
+    vector<double> tau;
+    int m, n;
+    bool explicit_q = false;
+    int sign = 1;          // определитель произведения отражений
+
+    // Отражения для столбцов k0..k1-1, применяются только внутри панели
+    void factor_panel(int k0, int k1){
+        double** a = qr.data;
+        vector<double> w(n);
+        for (int j = k0; j < k1; ++j){
+            double norm = 0.0;
+            for (int i = j; i < m; ++i){
+                norm += a[i][j] * a[i][j];
+            }
+            norm = sqrt(norm);
+            if (norm == 0.0){
+                tau[j] = 0.0;
+                continue;
+            }
+            double alpha = a[j][j];
+            double beta = -copysign(norm, alpha);
+            tau[j] = (beta - alpha) / beta;
+            double scale = 1.0 / (alpha - beta);
+            for (int i = j + 1; i < m; ++i){
+                a[i][j] *= scale;
+            }
+            a[j][j] = beta;
+            sign = -sign;
+
+            // Применяем H = I - tau v v^T к оставшимся столбцам панели
+            for (int c = j + 1; c < k1; ++c){
+                w[c] = a[j][c];
+            }
+            for (int i = j + 1; i < m; ++i){
+                double v = a[i][j];
+                for (int c = j + 1; c < k1; ++c){
+                    w[c] += v * a[i][c];
+                }
+            }
+            for (int c = j + 1; c < k1; ++c){
+                w[c] *= tau[j];
+                a[j][c] -= w[c];
+            }
+            for (int i = j + 1; i < m; ++i){
+                double v = a[i][j];
+                for (int c = j + 1; c < k1; ++c){
+                    a[i][c] -= w[c] * v;
+                }
+            }
+        }
+    }
+
+    // Элемент i вектора Хаусхолдера номер j (с единицей на диагонали)
+    double householder(int i, int j) const{
+        if (i < j)
+            return 0.0;
+        if (i == j)
+            return 1.0;
+        return qr.data[i][j];
+    }
+
+    // Применяет панель k0..k1-1 к столбцам k1..n-1: C = (I - V T^T V^T) C
+    void apply_panel(int k0, int k1){
+        int nb = k1 - k0, nc = n - k1;
+        if (nc <= 0)
+            return;
+        double** a = qr.data;
+
+        // Треугольный множитель T
+        vector<vector<double>> T(nb, vector<double>(nb, 0.0));
+        vector<double> z(nb);
+        for (int j = 0; j < nb; ++j){
+            T[j][j] = tau[k0 + j];
+            for (int p = 0; p < j; ++p){
+                double s = 0.0;
+                for (int i = k0 + j; i < m; ++i){
+                    s += householder(i, k0 + p) * householder(i, k0 + j);
+                }
+                z[p] = s;
+            }
+            for (int p = 0; p < j; ++p){
+                double s = 0.0;
+                for (int r = p; r < j; ++r){
+                    s += T[p][r] * z[r];
+                }
+                T[p][j] = -tau[k0 + j] * s;
+            }
+        }
+
+        // W = V^T C, обходим C построчно
+        vector<vector<double>> W(nb, vector<double>(nc, 0.0));
+        for (int i = k0; i < m; ++i){
+            const double* c = a[i] + k1;
+            for (int p = 0; p < nb && k0 + p <= i; ++p){
+                double v = householder(i, k0 + p);
+                double* wp = W[p].data();
+                for (int j = 0; j < nc; ++j){
+                    wp[j] += v * c[j];
+                }
+            }
+        }
+        // W = T^T W (T верхнетреугольная, идём снизу вверх)
+        for (int p = nb - 1; p >= 0; --p){
+            double* wp = W[p].data();
+            for (int j = 0; j < nc; ++j){
+                wp[j] *= T[p][p];
+            }
+            for (int r = 0; r < p; ++r){
+                double t = T[r][p];
+                if (t == 0.0)
+                    continue;
+                const double* wr = W[r].data();
+                for (int j = 0; j < nc; ++j){
+                    wp[j] += t * wr[j];
+                }
+            }
+        }
+        // C = C - V W
+        for (int i = k0; i < m; ++i){
+            double* c = a[i] + k1;
+            for (int p = 0; p < nb && k0 + p <= i; ++p){
+                double v = householder(i, k0 + p);
+                const double* wp = W[p].data();
+                for (int j = 0; j < nc; ++j){
+                    c[j] -= v * wp[j];
+                }
+            }
+        }
+    }
+
+    // B = Q^T B (B - m x k), по одному отражению
+    void apply_qt(Matrix& B) const{
+        double** b = B.data;
+        int k = B.cols;
+        if (explicit_q){
+            Matrix result(n, k, 0.0);
+            for (int i = 0; i < m; ++i){
+                for (int r = 0; r < n; ++r){
+                    double qir = q.data[i][r];
+                    for (int j = 0; j < k; ++j){
+                        result.data[r][j] += qir * b[i][j];
+                    }
+                }
+            }
+            B = move(result);
+            return;
+        }
+        vector<double> w(k);
+        for (int r = 0; r < min(m, n); ++r){
+            if (tau[r] == 0.0)
+                continue;
+            copy(b[r], b[r] + k, w.begin());
+            for (int i = r + 1; i < m; ++i){
+                double v = qr.data[i][r];
+                for (int j = 0; j < k; ++j){
+                    w[j] += v * b[i][j];
+                }
+            }
+            for (int j = 0; j < k; ++j){
+                w[j] *= tau[r];
+                b[r][j] -= w[j];
+            }
+            for (int i = r + 1; i < m; ++i){
+                double v = qr.data[i][r];
+                for (int j = 0; j < k; ++j){
+                    b[i][j] -= v * w[j];
+                }
+            }
+        }
+    }
+
+public:
+    QR(const Matrix& A) : qr(A.clone()), tau(min(A.rows, A.cols), 0.0), m(A.rows), n(A.cols){
+        int k = min(m, n);
+        for (int k0 = 0; k0 < k; k0 += NB){
+            int k1 = min(k0 + NB, k);
+            factor_panel(k0, k1);
+            apply_panel(k0, k1);
+        }
+    }
+
+    // Тонкая Q (m x min(m, n))
+    Matrix Q() const{
+        int k = min(m, n);
+        if (explicit_q){
+            return q.clone();
+        }
+        Matrix result = Matrix::Identity(m, k);
+        for (int r = k - 1; r >= 0; --r){
+            if (tau[r] == 0.0)
+                continue;
+            for (int j = r; j < k; ++j){
+                double w = result.data[r][j];
+                for (int i = r + 1; i < m; ++i){
+                    w += qr.data[i][r] * result.data[i][j];
+                }
+                w *= tau[r];
+                result.data[r][j] -= w;
+                for (int i = r + 1; i < m; ++i){
+                    result.data[i][j] -= w * qr.data[i][r];
+                }
+            }
+        }
+        return result;
+    }
+
+    // Верхнетреугольная R (min(m, n) x n)
+    Matrix R() const{
+        int k = min(m, n);
+        Matrix result(k, n, 0.0);
+        for (int i = 0; i < k; ++i){
+            copy(qr.data[i] + i, qr.data[i] + n, result.data[i] + i);
+        }
+        return result;
+    }
+
+    /* Решение A X = B в смысле наименьших квадратов (m >= n):
+    X = R^{-1} Q^T B, обратный ход по строкам */
+    Matrix solve(const Matrix& B) const{
+        if (B.rows != m){
+            throw invalid_argument("QR::solve: B must have " + to_string(m) + " rows");
+        }
+        if (m < n){
+            throw invalid_argument("QR::solve: system is underdetermined");
+        }
+        Matrix C = B.clone();
+        apply_qt(C);
+        int k = B.cols;
+        Matrix X(n, k);
+        for (int i = n - 1; i >= 0; --i){
+            double rii = qr.data[i][i];
+            if (rii == 0.0){
+                throw runtime_error("QR::solve: matrix is rank deficient");
+            }
+            double* x = X.data[i];
+            copy(C.data[i], C.data[i] + k, x);
+            for (int p = i + 1; p < n; ++p){
+                double r = qr.data[i][p];
+                const double* xp = X.data[p];
+                for (int j = 0; j < k; ++j){
+                    x[j] -= r * xp[j];
+                }
+            }
+            for (int j = 0; j < k; ++j){
+                x[j] /= rii;
+            }
+        }
+        return X;
     }
 
-    Matrix operator/(const Matrix& other) const{
-        return *this * other.reverse();
+    // Определитель квадратной A: произведение диагонали R со знаком отражений
+    double determinant() const{
+        if (m != n){
+            throw invalid_argument("QR::determinant: matrix is not square");
+        }
+        double det = sign;
+        for (int i = 0; i < n; ++i){
+            det *= qr.data[i][i];
+        }
+        return det;
     }
 
-    Matrix operator+(double scalar) const{
-        Matrix result(rows, cols);
-        for (int i = 0; i < rows; ++i){
-            for (int j = 0; j < cols; ++j){
-                result.data[i][j] = data[i][j] + scalar;
+    /* Добавление строки к A (новое наблюдение в задаче наименьших квадратов).
+    R обновляется n вращениями Гивенса за O(n^2), но каждое вращение
+    применяется и к m + 1 строкам явной Q, а Q копируется в новую матрицу:
+    итого O(m n) на строку. Первый вызов ещё собирает Q за O(m n^2) */
+    void add_row(const vector<double>& row){
+        if ((int)row.size() != n){
+            throw invalid_argument("QR::add_row: row must have " + to_string(n) + " elements");
+        }
+        if (m < n){
+            throw invalid_argument("QR::add_row: matrix has fewer rows than columns");
+        }
+        if (!explicit_q){
+            q = Q();
+            explicit_q = true;
+        }
+        // Новые строки: R в верхней части qr, Q дополняется строкой нулей
+        Matrix nq(m + 1, n, 0.0);
+        Matrix nr(n, n, 0.0);
+        for (int i = 0; i < m; ++i){
+            copy(q.data[i], q.data[i] + n, nq.data[i]);
+        }
+        for (int i = 0; i < n; ++i){
+            copy(qr.data[i] + i, qr.data[i] + n, nr.data[i] + i);
+        }
+        vector<double> r = row;
+        vector<double> qn(m + 1, 0.0);   // последний столбец расширенной Q
+        qn[m] = 1.0;
+        for (int j = 0; j < n; ++j){
+            if (r[j] == 0.0)
+                continue;
+            double h = hypot(nr.data[j][j], r[j]);
+            double c = nr.data[j][j] / h;
+            double s = r[j] / h;
+            for (int p = j; p < n; ++p){
+                double x = nr.data[j][p], y = r[p];
+                nr.data[j][p] = c * x + s * y;
+                r[p] = -s * x + c * y;
+            }
+            for (int i = 0; i <= m; ++i){
+                double x = nq.data[i][j], y = qn[i];
+                nq.data[i][j] = c * x + s * y;
+                qn[i] = -s * x + c * y;
             }
         }
-        return result;
+        q = move(nq);
+        qr = move(nr);
+        m = m + 1;
     }
+};
 
+/* Разложение Холецкого A = L * L^T для симметричной положительно
+определённой матрицы (используется нижний треугольник A).
+Блочный правосторонний вариант: блок на диагонали, затем панель под ним,
+затем обновление оставшейся части скалярными произведениями строк */
+class Cholesky{
+private:
+    static const int NB = 64;
+    Matrix L;
+    int n;
 
-    Matrix operator-(double scalar) const{
-        Matrix result(rows, cols);
-        for (int i = 0; i < rows; ++i){
-            for (int j = 0; j < cols; ++j){
-                result.data[i][j] = data[i][j] - scalar;
+public:
+    Cholesky(const Matrix& A) : L(A.clone()), n(A.rows){
+        if (A.rows != A.cols){
+            throw invalid_argument("Cholesky: matrix is not square");
+        }
+        double** a = L.data;
+        for (int k0 = 0; k0 < n; k0 += NB){
+            int k1 = min(k0 + NB, n);
+            // Диагональный блок
+            for (int j = k0; j < k1; ++j){
+                double s = a[j][j];
+                for (int p = k0; p < j; ++p){
+                    s -= a[j][p] * a[j][p];
+                }
+                if (!(s > 0.0)){
+                    throw runtime_error("Cholesky: matrix is not positive definite");
+                }
+                a[j][j] = sqrt(s);
+                for (int i = j + 1; i < k1; ++i){
+                    double t = a[i][j];
+                    for (int p = k0; p < j; ++p){
+                        t -= a[i][p] * a[j][p];
+                    }
+                    a[i][j] = t / a[j][j];
+                }
+            }
+            // Панель под блоком: L21 = A21 * L11^{-T}
+            for (int i = k1; i < n; ++i){
+                for (int j = k0; j < k1; ++j){
+                    double t = a[i][j];
+                    for (int p = k0; p < j; ++p){
+                        t -= a[i][p] * a[j][p];
+                    }
+                    a[i][j] = t / a[j][j];
+                }
+            }
+            // Оставшаяся часть: A22 -= L21 * L21^T (только нижний треугольник)
+            for (int i = k1; i < n; ++i){
+                const double* li = a[i] + k0;
+                for (int j = k1; j <= i; ++j){
+                    const double* lj = a[j] + k0;
+                    double t = 0.0;
+                    for (int p = 0; p < k1 - k0; ++p){
+                        t += li[p] * lj[p];
+                    }
+                    a[i][j] -= t;
+                }
             }
         }
-        return result;
+        for (int i = 0; i < n; ++i){
+            fill(a[i] + i + 1, a[i] + n, 0.0);
+        }
     }
 
-    Matrix operator*(double scalar) const{
-        Matrix result(rows, cols);
-        for (int i = 0; i < rows; ++i){
-            for (int j = 0; j < cols; ++j){
-                result.data[i][j] = data[i][j] * scalar;
+    // Нижнетреугольный множитель L
+    Matrix factor() const{
+        return L.clone();
+    }
+
+    // Решение A X = B: прямой ход L Y = B, затем обратный L^T X = Y
+    Matrix solve(const Matrix& B) const{
+        if (B.rows != n){
+            throw invalid_argument("Cholesky::solve: B must have " + to_string(n) + " rows");
+        }
+        int k = B.cols;
+        Matrix X = B.clone();
+        double** x = X.data;
+        for (int i = 0; i < n; ++i){
+            for (int p = 0; p < i; ++p){
+                double l = L.data[i][p];
+                for (int j = 0; j < k; ++j){
+                    x[i][j] -= l * x[p][j];
+                }
+            }
+            for (int j = 0; j < k; ++j){
+                x[i][j] /= L.data[i][i];
+            }
+        }
+        for (int i = n - 1; i >= 0; --i){
+            for (int j = 0; j < k; ++j){
+                x[i][j] /= L.data[i][i];
+            }
+            for (int p = 0; p < i; ++p){
+                double l = L.data[i][p];
+                for (int j = 0; j < k; ++j){
+                    x[p][j] -= l * x[i][j];
+                }
             }
         }
+        return X;
+    }
+
+    double determinant() const{
+        double det = 1.0;
+        for (int i = 0; i < n; ++i){
+            det *= L.data[i][i] * L.data[i][i];
+        }
+        return det;
+    }
+
+    // Логарифм определителя (не переполняется для больших матриц)
+    double log_determinant() const{
+        double result = 0.0;
+        for (int i = 0; i < n; ++i){
+            result += 2.0 * log(L.data[i][i]);
+        }
         return result;
     }
 
-    Matrix operator/(double scalar) const{
-        Matrix result(rows, cols);
-        if (scalar != 0){
-            for (int i = 0; i < rows; ++i){
-                for (int j = 0; j < cols; ++j){
-                    result.data[i][j] = data[i][j] / scalar;
-                }
+    // Обновление ранга 1: разложение для A + x x^T за O(n^2)
+    void update(vector<double> x){
+        if ((int)x.size() != n){
+            throw invalid_argument("Cholesky::update: vector must have " + to_string(n) + " elements");
+        }
+        // Копия разложения делит L с оригиналом, пишем в свой буфер
+        L.detach();
+        double** l = L.data;
+        for (int k = 0; k < n; ++k){
+            double r = hypot(l[k][k], x[k]);
+            double c = r / l[k][k];
+            double s = x[k] / l[k][k];
+            l[k][k] = r;
+            for (int i = k + 1; i < n; ++i){
+                l[i][k] = (l[i][k] + s * x[i]) / c;
+                x[i] = c * x[i] - s * l[i][k];
             }
         }
-        return result;
     }
 
-    friend ostream& operator<<(ostream& os, const Matrix& matrix){
-        os << "[";
-        for (int i = 0; i < matrix.rows; ++i){
-            os << "[";
-            for (int j = 0; j < matrix.cols; ++j){
-                os << matrix.data[i][j];
-                if (j < matrix.cols - 1){
-                    os << ", ";
+    // Понижение ранга 1: разложение для A - x x^T, если она остаётся положительно определённой
+    void downdate(vector<double> x){
+        if ((int)x.size() != n){
+            throw invalid_argument("Cholesky::downdate: vector must have " + to_string(n) + " elements");
+        }
+        Matrix saved = L.clone();
+        L.detach();
+        double** l = L.data;
+        for (int k = 0; k < n; ++k){
+            double r2 = l[k][k] * l[k][k] - x[k] * x[k];
+            if (!(r2 > 0.0)){
+                L = move(saved);
+                throw runtime_error("Cholesky::downdate: result is not positive definite");
+            }
+            double r = sqrt(r2);
+            double c = r / l[k][k];
+            double s = x[k] / l[k][k];
+            l[k][k] = r;
+            for (int i = k + 1; i < n; ++i){
+                l[i][k] = (l[i][k] - s * x[i]) / c;
+                x[i] = c * x[i] - s * l[i][k];
+            }
+        }
+    }
+};
+
+/* Пул потоков: задачи берутся из общей очереди.
+При уничтожении пул дожидается выполнения всех поставленных задач */
+class ThreadPool{
+private:
+    vector<thread> workers;
+    queue<function<void()>> tasks;
+    mutex mtx;
+    condition_variable cv;
+    bool stop = false;
+
+public:
+    ThreadPool(int threads = thread::hardware_concurrency()){
+        threads = max(threads, 1);
+        for (int i = 0; i < threads; ++i){
+            workers.emplace_back([this]{
+                while (true){
+                    function<void()> task;
+                    {
+                        unique_lock<mutex> lock(mtx);
+                        cv.wait(lock, [this]{ return stop || !tasks.empty(); });
+                        if (stop && tasks.empty())
+                            return;
+                        task = move(tasks.front());
+                        tasks.pop();
+                    }
+                    task();
                 }
+            });
+        }
+    }
+
+    ~ThreadPool(){
+        {
+            lock_guard<mutex> lock(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        for (auto& worker : workers){
+            worker.join();
+        }
+    }
+
+    void submit(function<void()> task){
+        {
+            lock_guard<mutex> lock(mtx);
+            tasks.push(move(task));
+        }
+        cv.notify_one();
+    }
+
+    int size() const{
+        return workers.size();
+    }
+};
+
+
+class MatrixGraph;
+
+/* Узел графа вычислений: результат - матрица или число.
+Узел ставится в пул, как только готовы все его входы */
+struct GraphNode{
+    enum Op { Input, Constant, Add, Sub, Mul, Div, Neg, Transpose, Sum,
+              AddScalar, SubScalar, MulScalar, DivScalar,
+              ScalarSubMatrix,                                // число - матрица
+              ScalarAdd, ScalarSub, ScalarMul, ScalarDiv };   // число с числом
+    Op op;
+    GraphNode* lhs = nullptr;
+    GraphNode* rhs = nullptr;
+    bool is_scalar = false;
+
+    Matrix value;
+    double number = 0.0;
+    exception_ptr error;
+
+    int pending = 0;                 // сколько входов ещё не готово
+    bool done = false;
+    vector<GraphNode*> dependents;   // кого разбудить после вычисления
+    promise<void> ready;
+    shared_future<void> ready_future = ready.get_future().share();
+};
+
+/* Дескриптор узла. Операции над ним не считают сразу, а добавляют узел в граф
+и возвращают новый дескриптор; get() ждёт результат */
+class Expr{
+private:
+    MatrixGraph* graph;
+    GraphNode* node;
+
+public:
+    Expr(MatrixGraph* g, GraphNode* n) : graph(g), node(n) {}
+
+    MatrixGraph* owner() const{ return graph; }
+    GraphNode* target() const{ return node; }
+    bool is_scalar() const{ return node->is_scalar; }
+
+    Expr transpose() const;
+    Expr sum() const;
+    Expr operator-() const;
+
+    // Ожидание результата (исключение из вычисления пробрасывается сюда)
+    const Matrix& get() const{
+        node->ready_future.get();
+        return node->value;
+    }
+
+    double scalar() const{
+        node->ready_future.get();
+        return node->number;
+    }
+};
+
+/* Граф вычислений над матрицами. Одинаковые подвыражения (та же операция
+над теми же узлами) создаются один раз, так что A.transpose() в выражении
+посчитается единожды, сколько бы раз он ни встречался */
+class MatrixGraph{
+private:
+    ThreadPool& pool;
+    mutex mtx;
+    deque<GraphNode> nodes;
+    map<tuple<int, GraphNode*, GraphNode*, double>, GraphNode*> memo;
+
+    static void compute(GraphNode* n){
+        const GraphNode* a = n->lhs;
+        const GraphNode* b = n->rhs;
+        switch (n->op){
+            case GraphNode::Add:       n->value = a->value + b->value; break;
+            case GraphNode::Sub:       n->value = a->value - b->value; break;
+            case GraphNode::Mul:       n->value = a->value * b->value; break;
+            case GraphNode::Div:       n->value = a->value / b->value; break;
+            case GraphNode::Neg:       n->value = -a->value; break;
+            case GraphNode::Transpose: n->value = a->value.transpose(); break;
+            case GraphNode::Sum:       n->number = a->value.sum(); break;
+            case GraphNode::AddScalar: n->value = a->value + b->number; break;
+            case GraphNode::SubScalar: n->value = a->value - b->number; break;
+            case GraphNode::MulScalar: n->value = a->value * b->number; break;
+            case GraphNode::DivScalar: n->value = a->value / b->number; break;
+            case GraphNode::ScalarSubMatrix: n->value = -b->value + a->number; break;
+            case GraphNode::ScalarAdd: n->number = a->number + b->number; break;
+            case GraphNode::ScalarSub: n->number = a->number - b->number; break;
+            case GraphNode::ScalarMul: n->number = a->number * b->number; break;
+            case GraphNode::ScalarDiv:
+                MatrixCheck::divisor(b->number);
+                n->number = a->number / b->number;
+                break;
+            default: break;
+        }
+    }
+
+    // Выполнение узла в пуле и запуск зависимых, у которых готовы все входы
+    void run(GraphNode* n){
+        if (n->lhs && n->lhs->error)
+            n->error = n->lhs->error;
+        else if (n->rhs && n->rhs->error)
+            n->error = n->rhs->error;
+        else{
+            try{
+                compute(n);
             }
-            os << "]";
-            if (i < matrix.rows - 1){
-                os << ", ";
+            catch (...){
+                n->error = current_exception();
             }
         }
-        os << "]";
-        return os;
+        vector<GraphNode*> ready_nodes;
+        {
+            lock_guard<mutex> lock(mtx);
+            n->done = true;
+            for (GraphNode* d : n->dependents){
+                if (--d->pending == 0)
+                    ready_nodes.push_back(d);
+            }
+            if (n->error)
+                n->ready.set_exception(n->error);
+            else
+                n->ready.set_value();
+        }
+        for (GraphNode* d : ready_nodes){
+            pool.submit([this, d]{ run(d); });
+        }
+    }
+
+    GraphNode* finished(GraphNode::Op op, double number, bool is_scalar){
+        nodes.emplace_back();
+        GraphNode* n = &nodes.back();
+        n->op = op;
+        n->number = number;
+        n->is_scalar = is_scalar;
+        n->done = true;
+        n->ready.set_value();
+        return n;
+    }
+
+public:
+    MatrixGraph(ThreadPool& p) : pool(p) {}
+
+    // Граф нельзя разрушать, пока в пуле есть его задачи
+    ~MatrixGraph(){
+        for (auto& n : nodes){
+            n.ready_future.wait();
+        }
+        // Последний run() мог ещё не отпустить мьютекс
+        lock_guard<mutex> lock(mtx);
+    }
+
+    // Входная матрица (данные не копируются)
+    Expr input(const Matrix& m){
+        lock_guard<mutex> lock(mtx);
+        GraphNode* n = finished(GraphNode::Input, 0.0, false);
+        n->value = Matrix(m);
+        return Expr(this, n);
+    }
+
+    Expr constant(double value){
+        lock_guard<mutex> lock(mtx);
+        auto key = make_tuple((int)GraphNode::Constant, (GraphNode*)nullptr, (GraphNode*)nullptr, value);
+        auto it = memo.find(key);
+        if (it != memo.end())
+            return Expr(this, it->second);
+        GraphNode* n = finished(GraphNode::Constant, value, true);
+        memo[key] = n;
+        return Expr(this, n);
+    }
+
+    // Добавление операции; если такая уже есть в графе, возвращается она
+    Expr apply(GraphNode::Op op, const Expr& a, const Expr* b = nullptr){
+        GraphNode* lhs = a.target();
+        GraphNode* rhs = b ? b->target() : nullptr;
+        bool submit_now = false;
+        GraphNode* n;
+        {
+            lock_guard<mutex> lock(mtx);
+            auto key = make_tuple((int)op, lhs, rhs, 0.0);
+            auto it = memo.find(key);
+            if (it != memo.end())
+                return Expr(this, it->second);
+            nodes.emplace_back();
+            n = &nodes.back();
+            n->op = op;
+            n->lhs = lhs;
+            n->rhs = rhs;
+            n->is_scalar = (op == GraphNode::Sum || op >= GraphNode::ScalarAdd);
+            for (GraphNode* in : {lhs, rhs}){
+                if (in && !in->done){
+                    n->pending++;
+                    in->dependents.push_back(n);
+                }
+            }
+            submit_now = (n->pending == 0);
+            memo[key] = n;
+        }
+        if (submit_now)
+            pool.submit([this, n]{ run(n); });
+        return Expr(this, n);
     }
 };
 
+// Для числа транспонирование и сумма ничего не меняют
+inline Expr Expr::transpose() const{
+    if (is_scalar())
+        return *this;
+    return graph->apply(GraphNode::Transpose, *this);
+}
+
+inline Expr Expr::sum() const{
+    if (is_scalar())
+        return *this;
+    return graph->apply(GraphNode::Sum, *this);
+}
+
+inline Expr Expr::operator-() const{
+    if (is_scalar())
+        return graph->apply(GraphNode::ScalarSub, graph->constant(0.0), this);
+    return graph->apply(GraphNode::Neg, *this);
+}
+
+/* Операция выбирается по типам операндов: матрица с матрицей, матрица
+с числом, число с матрицей (для + и * операнды меняются местами) или
+число с числом (результат - число). Деление числа на матрицу не определено */
+inline Expr operator+(const Expr& a, const Expr& b){
+    if (a.is_scalar() && b.is_scalar())
+        return a.owner()->apply(GraphNode::ScalarAdd, a, &b);
+    if (a.is_scalar())
+        return b + a;
+    return a.owner()->apply(b.is_scalar() ? GraphNode::AddScalar : GraphNode::Add, a, &b);
+}
+
+inline Expr operator-(const Expr& a, const Expr& b){
+    if (a.is_scalar())
+        return a.owner()->apply(b.is_scalar() ? GraphNode::ScalarSub : GraphNode::ScalarSubMatrix, a, &b);
+    return a.owner()->apply(b.is_scalar() ? GraphNode::SubScalar : GraphNode::Sub, a, &b);
+}
+
+inline Expr operator*(const Expr& a, const Expr& b){
+    if (a.is_scalar() && b.is_scalar())
+        return a.owner()->apply(GraphNode::ScalarMul, a, &b);
+    if (a.is_scalar())
+        return b * a;
+    return a.owner()->apply(b.is_scalar() ? GraphNode::MulScalar : GraphNode::Mul, a, &b);
+}
+
+inline Expr operator/(const Expr& a, const Expr& b){
+    if (a.is_scalar() && !b.is_scalar())
+        throw invalid_argument("Expr::operator/: cannot divide a number by a matrix");
+    if (a.is_scalar())
+        return a.owner()->apply(GraphNode::ScalarDiv, a, &b);
+    return a.owner()->apply(b.is_scalar() ? GraphNode::DivScalar : GraphNode::Div, a, &b);
+}
+
+inline Expr operator+(const Expr& a, double b){ return a + a.owner()->constant(b); }
+inline Expr operator-(const Expr& a, double b){ return a - a.owner()->constant(b); }
+inline Expr operator*(const Expr& a, double b){ return a * a.owner()->constant(b); }
+inline Expr operator/(const Expr& a, double b){ return a / a.owner()->constant(b); }
+
+
+// Максимальный по модулю элемент матрицы (для оценки невязок)
+double max_abs(const Matrix& m){
+    double result = 0.0;
+    for (int i = 1; i <= m.rows; ++i){
+        for (int j = 1; j <= m.cols; ++j){
+            result = max(result, fabs(m(i, j)));
+        }
+    }
+    return result;
+}
+
+/* Замеры: время и точность спектральных разложений для матриц n x n.
+Запуск: ./Matrix_finale bench eig [n1 n2 ...] (по умолчанию 200 500 1000 2000) */
+void benchmark_eigen(const vector<int>& sizes){
+    for (int n : sizes){
+        Matrix R = Matrix::Random(n, n);
+        Matrix S = (R + R.transpose()) * 0.5;
+
+        auto start = chrono::steady_clock::now();
+        Matrix V;
+        vector<double> lambda = S.eigen_symmetric(&V);
+        double t_sym = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        // Невязка |S V - V diag(lambda)| / |S|
+        double res_sym = max_abs(S * V - V * Matrix::Diagonal(lambda)) / max_abs(S);
+
+        start = chrono::steady_clock::now();
+        vector<complex<double>> mu = R.eigenvalues();
+        double t_gen = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        // След матрицы равен сумме собственных значений
+        complex<double> trace_eig = 0.0;
+        double trace = 0.0;
+        for (int i = 0; i < n; ++i){
+            trace_eig += mu[i];
+            trace += R(i + 1, i + 1);
+        }
+        double res_gen = abs(trace_eig - trace) / max(1.0, fabs(trace));
+        /* След не видит ошибок в отдельных значениях, поэтому ещё две проверки:
+        ln|det R| (по диагонали R из QR-разложения) равен сумме ln|mu|,
+        а на симметричной S значения должны совпасть с eigen_symmetric */
+        double log_det = 0.0, log_det_eig = 0.0;
+        Matrix Rq = QR(R).R();
+        for (int i = 0; i < n; ++i){
+            log_det += log(fabs(Rq(i + 1, i + 1)));
+            log_det_eig += log(abs(mu[i]));
+        }
+        double res_det = fabs(log_det - log_det_eig) / max(1.0, fabs(log_det));
+        vector<complex<double>> mu_sym = S.eigenvalues();
+        vector<double> mu_sym_re(n);
+        double res_vs_sym = 0.0, lambda_max = 0.0;
+        for (int i = 0; i < n; ++i){
+            mu_sym_re[i] = mu_sym[i].real();
+            res_vs_sym = max(res_vs_sym, fabs(mu_sym[i].imag()));
+            lambda_max = max(lambda_max, fabs(lambda[i]));
+        }
+        sort(mu_sym_re.begin(), mu_sym_re.end());
+        for (int i = 0; i < n; ++i){
+            res_vs_sym = max(res_vs_sym, fabs(mu_sym_re[i] - lambda[i]));
+        }
+        res_vs_sym /= lambda_max;
+
+        start = chrono::steady_clock::now();
+        Matrix U, W;
+        vector<double> sigma = R.svd(&U, &W);
+        double t_svd = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        // Невязка |R - U diag(s) W^T| / |R|
+        double res_svd = max_abs(R - U * Matrix::Diagonal(sigma) * W.transpose()) / max_abs(R);
+
+        cout << "n = " << n
+             << " | eigen_symmetric " << t_sym << " s, nevyazka " << res_sym
+             << " | eigenvalues " << t_gen << " s, sled " << res_gen << ", ln|det| " << res_det
+             << ", protiv eigen_symmetric " << res_vs_sym
+             << " | svd " << t_svd << " s, nevyazka " << res_svd << endl;
+    }
+}
+
+/* Замеры: обращение через QR и Холецкого против reverse().
+Запуск: ./Matrix_finale bench qr [n1 n2 ...] (по умолчанию 6 8 100 500 1000) */
+void benchmark_factor(const vector<int>& sizes){
+    for (int n : sizes){
+        Matrix R = Matrix::Random(n, n);
+        // Симметричная положительно определённая матрица
+        Matrix A = R * R.transpose() + Matrix::Identity(n, n) * n;
+        Matrix I = Matrix::Identity(n, n);
+        cout << "n = " << n;
+
+        auto start = chrono::steady_clock::now();
+        Matrix X = A.reverse();
+        double t = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << " | reverse " << t << " s, nevyazka " << max_abs(A * X - I);
+
+        start = chrono::steady_clock::now();
+        QR qr(A);
+        X = qr.solve(I);
+        t = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << " | QR " << t << " s, nevyazka " << max_abs(A * X - I);
+
+        start = chrono::steady_clock::now();
+        Cholesky chol(A);
+        Matrix Y = chol.solve(I);
+        t = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << " | Cholesky " << t << " s, nevyazka " << max_abs(A * Y - I) << endl;
+    }
+}
+
+/* Замеры: выражение из main() последовательно и через граф.
+Запуск: ./Matrix_finale bench graph [n1 n2 ...] (по умолчанию 200 500 1000) */
+void benchmark_graph(const vector<int>& sizes){
+    ThreadPool pool;
+    for (int n : sizes){
+        Matrix A = Matrix::Random(n, n);
+        Matrix B = Matrix::Random(n, n);
+
+        auto start = chrono::steady_clock::now();
+        Matrix seq = ((A * B) - (B / A.transpose()) * A.sum()) + (B.transpose() * A / B.sum());
+        double t_seq = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        start = chrono::steady_clock::now();
+        MatrixGraph graph(pool);
+        Expr a = graph.input(A), b = graph.input(B);
+        Matrix par = (((a * b) - (b / a.transpose()) * a.sum()) + (b.transpose() * a / b.sum())).get();
+        double t_par = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        cout << "n = " << n << " | posledovatelno " << t_seq << " s | graf (" << pool.size()
+             << " potokov) " << t_par << " s | raznitsa " << max_abs(seq - par) << endl;
+    }
+}
+
+/* Замеры: цена проверок. Сумма всех элементов через operator()
+(политика по умолчанию), через at<CheckedPolicy>() и через sum() без индексов.
+При сборке без -DMATRIX_CHECKED первый и третий столбцы должны совпадать.
+Запуск: ./Matrix_finale bench check [n1 n2 ...] (по умолчанию 100 1000 3000) */
+void benchmark_check(const vector<int>& sizes){
+    for (int n : sizes){
+        Matrix A = Matrix::Random(n, n);
+        int repeats = max(1, 100000000 / (n * n));
+        double total = 0.0;
+
+        auto start = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; ++r){
+            total += A.sum();
+        }
+        double t_sum = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; ++r){
+            for (int i = 1; i <= n; ++i){
+                for (int j = 1; j <= n; ++j){
+                    total += A(i, j);
+                }
+            }
+        }
+        double t_default = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; ++r){
+            for (int i = 1; i <= n; ++i){
+                for (int j = 1; j <= n; ++j){
+                    total += A.at<CheckedPolicy>(i, j);
+                }
+            }
+        }
+        double t_checked = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        double elements = double(repeats) * n * n;
+        cout << "n = " << n << " | sum() " << t_sum / elements * 1e9 << " ns/el | operator() "
+             << t_default / elements * 1e9 << " ns/el | at<CheckedPolicy> "
+             << t_checked / elements * 1e9 << " ns/el | (" << total << ")" << endl;
+    }
+}
+
+/* Замеры: pow, expm и polynomial против наивных повторных умножений через operator*.
+Для expm наивный вариант - ряд Тейлора до исчезающе малого члена, точность
+проверяется по спектральному разложению симметричной матрицы.
+Запуск: ./Matrix_finale bench pow [n1 n2 ...] (по умолчанию 50 100 200) */
+void benchmark_power(const vector<int>& sizes){
+    auto seconds_since = [](chrono::steady_clock::time_point start){
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    };
+    for (int n : sizes){
+        // Стохастическая по строкам матрица переходов
+        Matrix R = Matrix::Random(n, n);
+        vector<double> inverse_sums(n);
+        for (int i = 0; i < n; ++i){
+            double s = 0.0;
+            for (int j = 1; j <= n; ++j){
+                s += R(i + 1, j);
+            }
+            inverse_sums[i] = 1.0 / s;
+        }
+        Matrix P = Matrix::Diagonal(inverse_sums) * R;
+        int exponent = 200;
+
+        auto start = chrono::steady_clock::now();
+        Matrix naive = P;
+        for (int k = 1; k < exponent; ++k){
+            naive = naive * P;
+        }
+        double t_naive = seconds_since(start);
+        int count = 0;
+        start = chrono::steady_clock::now();
+        Matrix fast = P.pow(exponent, &count);
+        double t_fast = seconds_since(start);
+        cout << "n = " << n << " | P^" << exponent << ": naivno " << exponent - 1 << " umn. " << t_naive
+             << " s, pow " << count << " umn. " << t_fast << " s, raznitsa " << max_abs(naive - fast) << endl;
+
+        // Многочлен степени 30
+        vector<double> coeffs(31);
+        for (int k = 0; k <= 30; ++k){
+            coeffs[k] = 1.0 / (k + 1);
+        }
+        start = chrono::steady_clock::now();
+        Matrix horner = Matrix::Identity(n, n) * coeffs[30];
+        for (int k = 29; k >= 0; --k){
+            horner = horner * P + Matrix::Identity(n, n) * coeffs[k];
+        }
+        t_naive = seconds_since(start);
+        start = chrono::steady_clock::now();
+        Matrix ps = P.polynomial(coeffs, &count);
+        t_fast = seconds_since(start);
+        cout << "       | mnogochlen st. 30: Gorner 30 umn. " << t_naive << " s, Paterson-Stockmeyer "
+             << count << " umn. " << t_fast << " s, raznitsa " << max_abs(horner - ps) << endl;
+
+        // Экспонента симметричной матрицы с нормой порядка n
+        Matrix S = (R + R.transpose()) * 0.5;
+        Matrix V;
+        vector<double> lambda = S.eigen_symmetric(&V);
+        for (double& l : lambda){
+            l = exp(l);
+        }
+        Matrix exact = V * Matrix::Diagonal(lambda) * V.transpose();
+        double scale = max_abs(exact);
+
+        start = chrono::steady_clock::now();
+        Matrix term = Matrix::Identity(n, n), taylor = Matrix::Identity(n, n);
+        int taylor_count = 0;
+        for (int k = 1; max_abs(term) > 1e-17 * max_abs(taylor) && k < 1000; ++k){
+            term = term * S / k;
+            taylor = taylor + term;
+            ++taylor_count;
+        }
+        t_naive = seconds_since(start);
+        start = chrono::steady_clock::now();
+        Matrix e = S.expm(&count);
+        t_fast = seconds_since(start);
+        cout << "       | expm: Teilor " << taylor_count << " umn. " << t_naive << " s, oshibka "
+             << max_abs(taylor - exact) / scale << " | Pade " << count << " umn. " << t_fast
+             << " s, oshibka " << max_abs(e - exact) / scale << endl;
+    }
+}
+
+/* Замеры: solve в смешанной точности против solve в double для A x = b
+и для обращения (B = I). Ошибка - относительно известного решения.
+Последняя строка - плохо обусловленная матрица 100 x 100: float для неё
+слишком груб, и solve должен откатиться на double (уточнений -1).
+Запуск: ./Matrix_finale bench solve [n1 n2 ...] (по умолчанию 6 8 100 500 1000) */
+void benchmark_solve(const vector<int>& sizes){
+    auto report = [](const Matrix& A, const char* name){
+        int n = A.rows;
+        Matrix x = Matrix::Random(n, 1);
+        Matrix b = A * x;
+        Matrix I = Matrix::Identity(n, n);
+        cout << name;
+        for (SolvePrecision precision : {SolvePrecision::Double, SolvePrecision::Mixed}){
+            int refinements = 0;
+            auto start = chrono::steady_clock::now();
+            Matrix y = A.solve(b, precision, &refinements);
+            double t_vector = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            start = chrono::steady_clock::now();
+            Matrix X = A.solve(I, precision);
+            double t_inverse = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            cout << (precision == SolvePrecision::Double ? " | double: " : " | mixed: ")
+                 << "Ax=b " << t_vector << " s, oshibka " << max_abs(y - x) / max_abs(x)
+                 << ", A^-1 " << t_inverse << " s, nevyazka " << max_abs(A * X - I);
+            if (precision == SolvePrecision::Mixed)
+                cout << ", utochnenii " << refinements;
+        }
+        cout << endl;
+    };
+    for (int n : sizes){
+        report(Matrix::Random(n, n), ("n = " + to_string(n)).c_str());
+    }
+    // U diag(1 .. 1e-12) V^T: число обусловленности 1e12
+    Matrix U, V;
+    Matrix::Random(100, 100).svd(&U, &V);
+    vector<double> sigma(100);
+    for (int i = 0; i < 100; ++i){
+        sigma[i] = pow(10.0, -12.0 * i / 99);
+    }
+    report(U * Matrix::Diagonal(sigma) * V.transpose(), "cond 1e12, n = 100");
+}
+
+/* Замеры NUMA: чтение, транспонирование и умножение для матрицы, размещённой
+конструктором (всё на узле главного потока), кусками по узлам и вперемешку;
+затем пропускная способность чтения для каждого узла: потоки узла k читают
+матрицу, целиком лежащую на узле j. Топологию можно задать
+MATRIX_NUMA_NODES=N (условные узлы на одном настоящем).
+Запуск: ./Matrix_finale bench numa [n1 n2 ...] (по умолчанию 2000 4000) */
+void benchmark_numa(const vector<int>& sizes){
+    const NumaTopology& topology = NumaTopology::get();
+    cout << "uzlov: " << topology.nodes() << (topology.simulated() ? " (uslovnyh)" : "") << ", potokov: "
+         << topology.workers() << endl;
+    for (int k = 0; k < topology.nodes(); ++k){
+        cout << "uzel " << k << ": cpu";
+        for (int cpu : topology.cpus(k)){
+            cout << " " << cpu;
+        }
+        cout << endl;
+    }
+    auto seconds_since = [](chrono::steady_clock::time_point start){
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    };
+    for (int n : sizes){
+        double gigabytes = double(n) * n * sizeof(double) / 1e9;
+        // Умножение кубическое, поэтому для него размер поменьше
+        int nm = min(n, 1000);
+        const char* names[] = {"konstruktor", "kuskami", "vperemeshku"};
+        for (int p = 0; p < 3; ++p){
+            auto make = [&](int size){
+                if (p == 0)
+                    return Matrix(size, size, 1.0);
+                return Matrix::Numa(size, size, 1.0, p == 1 ? NumaPlacement::Partitioned : NumaPlacement::Interleaved);
+            };
+            Matrix A = make(n);
+            auto start = chrono::steady_clock::now();
+            double total = A.numa_sum();
+            double t_sum = seconds_since(start);
+            start = chrono::steady_clock::now();
+            Matrix T = A.numa_transpose();
+            double t_transpose = seconds_since(start);
+            Matrix B = make(nm);
+            start = chrono::steady_clock::now();
+            Matrix C = B.numa_multiply(B);
+            double t_multiply = seconds_since(start);
+            cout << "n = " << n << " | " << names[p] << ": summa " << gigabytes / t_sum << " GB/s, transp. "
+                 << 2 * gigabytes / t_transpose << " GB/s, umnozhenie " << nm << " x " << nm << " "
+                 << 2.0 * nm * nm * nm / t_multiply / 1e9 << " GFLOP/s (" << total + T.sum() + C.sum() << ")" << endl;
+        }
+        for (int j = 0; j < topology.nodes(); ++j){
+            Matrix A = Matrix::Numa(n, n, 1.0, NumaPlacement::Single, j);
+            cout << "n = " << n << " | matrica na uzle " << j << ", chtenie potokami uzla:";
+            for (int k = 0; k < topology.nodes(); ++k){
+                auto start = chrono::steady_clock::now();
+                double total = A.numa_sum(k);
+                double t = seconds_since(start);
+                cout << " " << k << ": " << gigabytes / t << " GB/s" << (total == double(n) * n ? "" : " (OSHIBKA)");
+            }
+            cout << endl;
+        }
+    }
+}
+
+
+int main(int argc, char* argv[]){
+    // ./Matrix_finale bench eig|qr|graph|check|pow|solve|numa [n1 n2 ...]
+    if (argc > 2 && string(argv[1]) == "bench"){
+        string group = argv[2];
+        vector<int> sizes;
+        for (int i = 3; i < argc; ++i){
+            sizes.push_back(stoi(argv[i]));
+        }
+        if (group == "eig"){
+            benchmark_eigen(sizes.empty() ? vector<int>{200, 500, 1000, 2000} : sizes);
+        }
+        else if (group == "qr"){
+            benchmark_factor(sizes.empty() ? vector<int>{6, 8, 100, 500, 1000} : sizes);
+        }
+        else if (group == "graph"){
+            benchmark_graph(sizes.empty() ? vector<int>{200, 500, 1000} : sizes);
+        }
+        else if (group == "check"){
+            benchmark_check(sizes.empty() ? vector<int>{100, 1000, 3000} : sizes);
+        }
+        else if (group == "pow"){
+            benchmark_power(sizes.empty() ? vector<int>{50, 100, 200} : sizes);
+        }
+        else if (group == "solve"){
+            benchmark_solve(sizes.empty() ? vector<int>{6, 8, 100, 500, 1000} : sizes);
+        }
+        else if (group == "numa"){
+            benchmark_numa(sizes.empty() ? vector<int>{2000, 4000} : sizes);
+        }
+        return 0;
+    }
 
-int main(){
     string matrix_string;
     //Считывание со строки квадратной матрицы A. Например:
     //[[2, 6, 7], [1, 0, 8], [4, 3, 6]]
@@ -360,7 +3381,11 @@ int main(){
     Matrix B = Matrix::Random(A.rows, A.cols);
     // Если матрица B не рандомная, то:
     //Matrix B = Matrix::FromString("[[2, 3, 4], [6, 7, 1], [3, 9, 8]]");
-    Matrix result = ((A * B) - (B / A.transpose()) * A.sum()) + (B.transpose() * A / B.sum());
+    // Независимые подвыражения считаются параллельно в пуле потоков
+    ThreadPool pool;
+    MatrixGraph graph(pool);
+    Expr a = graph.input(A), b = graph.input(B);
+    Matrix result = (((a * b) - (b / a.transpose()) * a.sum()) + (b.transpose() * a / b.sum())).get();
     cout << "Pri vypolnenii vyrazheniya ((A * B) - (B / AT) * <summa elementov A>) + (BT * A / <summa elementov B>), gde AT and BT - transponirovannye matricy, rezultat raven: " << result << endl;
     cout << endl;
     cout << A(1, 2) << endl; // обращение к элементу по индексу (счет начинается с 1, а не с 0)